@@ -0,0 +1,79 @@
+/**
+ * \file bucket_queue_benchmark.cc
+ * \brief Compares the tie-breaking policies of the A* open set.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ *
+ * Usage: bucket_queue_benchmark level-file...
+ *
+ * Each level is solved with A* once per BucketQueue::TieBreaking policy. The
+ * number of Nodes expanded in total and in the last fscore layer (the layer
+ * that contains the solution) is printed with the run time.
+ */
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <fmt/core.h>
+
+#include "astar.h"
+#include "boxedinio.h"
+#include "BucketQueue.h"
+#include "Heuristic.h"
+#include "Level.h"
+
+using namespace std;
+using namespace boxedin;
+
+typedef chrono::steady_clock bench_clock;
+
+static const struct
+{
+    BucketQueue::TieBreaking tie_breaking;
+    const char* name;
+} policies[] =
+{
+    {BucketQueue::TIE_BREAK_FIFO, "fifo"},
+    {BucketQueue::TIE_BREAK_LIFO, "lifo"},
+    {BucketQueue::TIE_BREAK_LOW_H_FIFO, "h-fifo"},
+    {BucketQueue::TIE_BREAK_LOW_H_LIFO, "h-lifo"},
+};
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s level-file...\n", argv[0]);
+        return 1;
+    }
+
+    fmt::print("{:<24} {:<7} {:>6} {:>12} {:>12} {:>10}\n",
+               "level", "policy", "moves", "expanded", "last layer", "ms");
+    for (int i = 1; i < argc; i++)
+    {
+        vector<vector<char> > charmap;
+        ifstream level_istream(argv[i]);
+        boxedin::io::ParseCharMap(level_istream, charmap);
+        if (!boxedin::io::IsValidBoxedInLevel(charmap))
+        {
+            fprintf(stderr, "ERROR: Invalid boxed in level %s\n", argv[i]);
+            return 1;
+        }
+        Level level = Level::MakeLevel(charmap);
+        ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+
+        for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); p++)
+        {
+            bench_clock::time_point t0 = bench_clock::now();
+            SearchResult result = astar(level, heuristic, policies[p].tie_breaking);
+            bench_clock::time_point t1 = bench_clock::now();
+
+            fmt::print("{:<24} {:<7} {:>6} {:>12} {:>12} {:>10.0f}\n",
+                       argv[i], policies[p].name, result.num_moves,
+                       result.nodes_expanded, result.last_layer_expanded,
+                       chrono::duration<double, milli>(t1 - t0).count());
+        }
+    }
+    return 0;
+}
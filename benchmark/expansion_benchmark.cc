@@ -0,0 +1,144 @@
+/**
+ * \file expansion_benchmark.cc
+ * \brief Measures how many Nodes per second the search can expand.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ *
+ * Usage: expansion_benchmark [level-file] [num-states] [repeat]
+ *
+ * Real search states are collected with a breadth first expansion of the
+ * level. Then find_actions(), is_unsolvable() and generate_successors() are
+ * timed over all of them, repeat times each. generate_successors() is one
+ * expansion: the actions of a Node and a new Node for each of them.
+ */
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <fmt/core.h>
+
+#include "astar.h"
+#include "boxedinio.h"
+#include "Heuristic.h"
+#include "Level.h"
+#include "Node.h"
+#include "TranspositionTable.h"
+
+using namespace std;
+using namespace boxedin;
+
+typedef chrono::steady_clock bench_clock;
+
+static double seconds(bench_clock::time_point t1, bench_clock::time_point t2)
+{
+    return chrono::duration<double>(t2 - t1).count();
+}
+
+static vector<Node*> collect_states(const Level& level, Heuristic& heuristic, size_t max_states)
+{
+    vector<Node*> states;
+    TranspositionTable seen;
+    Node* start = Node::MakeStartNode(level, heuristic);
+    seen.Insert(start, NULL);
+    states.push_back(start);
+
+    ActionVector actions;
+    for (size_t i = 0; i < states.size() && states.size() < max_states; i++)
+    {
+        find_actions(level, *states[i], actions);
+        for (size_t a = 0; a < actions.size(); a++)
+        {
+            Node* successor = new Node(level, heuristic, *states[i], actions[a]);
+            if (states.size() < max_states && seen.Find(*successor) == NULL)
+            {
+                seen.Insert(successor, NULL);
+                states.push_back(successor);
+            }
+            else
+            {
+                delete successor;
+            }
+        }
+    }
+    return states;
+}
+
+static void print_rate(const char* name, double elapsed, size_t n, size_t results)
+{
+    fmt::print("{:<20} {:8.1f} ns/state {:12.0f} states/s ({} results)\n",
+               name, elapsed * 1e9 / (double)n, (double)n / elapsed, results);
+}
+
+int main(int argc, char* argv[])
+{
+    string level_path = (argc > 1) ? argv[1] : "level-data/1/29.txt";
+    size_t max_states = (argc > 2) ? (size_t)atol(argv[2]) : 100000;
+    int repeat = (argc > 3) ? atoi(argv[3]) : 5;
+
+    vector<vector<char> > charmap;
+    ifstream level_istream(level_path.c_str());
+    boxedin::io::ParseCharMap(level_istream, charmap);
+    if (!boxedin::io::IsValidBoxedInLevel(charmap))
+    {
+        fprintf(stderr, "ERROR: Invalid boxed in level %s\n", level_path.c_str());
+        return 1;
+    }
+    Level level = Level::MakeLevel(charmap);
+    ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+
+    vector<Node*> states = collect_states(level, heuristic, max_states);
+    size_t n = states.size();
+    fmt::print("{}: {} states, {} passes\n", level_path, n, repeat);
+
+    ActionVector actions;
+    NodeVector successors;
+    size_t results = 0;
+
+    bench_clock::time_point t0 = bench_clock::now();
+    for (int r = 0; r < repeat; r++)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            find_actions(level, *states[i], actions);
+            results += actions.size();
+        }
+    }
+    bench_clock::time_point t1 = bench_clock::now();
+    print_rate("find_actions", seconds(t0, t1), n * repeat, results);
+
+    results = 0;
+    t0 = bench_clock::now();
+    for (int r = 0; r < repeat; r++)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            results += is_unsolvable(level, *states[i]);
+        }
+    }
+    t1 = bench_clock::now();
+    print_rate("is_unsolvable", seconds(t0, t1), n * repeat, results);
+
+    results = 0;
+    t0 = bench_clock::now();
+    for (int r = 0; r < repeat; r++)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            generate_successors(level, heuristic, *states[i], actions, successors);
+            results += successors.size();
+            for (size_t s = 0; s < successors.size(); s++)
+            {
+                delete successors[s];
+            }
+        }
+    }
+    t1 = bench_clock::now();
+    print_rate("generate_successors", seconds(t0, t1), n * repeat, results);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        delete states[i];
+    }
+    return 0;
+}
@@ -0,0 +1,157 @@
+/**
+ * \file transposition_table_benchmark.cc
+ * \brief Compares the TranspositionTable with the std::set open and closed
+ *        sets it replaced.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ *
+ * Usage: transposition_table_benchmark [level-file] [num-states]
+ *
+ * Real search states are collected with a breadth first expansion of the
+ * level, then the same sequence of A* operations is timed on both containers:
+ * open set lookup and insertion, open set to closed set transfer, and closed
+ * set lookup.
+ */
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <vector>
+#include <fmt/core.h>
+
+#include "astar.h"
+#include "boxedinio.h"
+#include "Heuristic.h"
+#include "Level.h"
+#include "Node.h"
+#include "TranspositionTable.h"
+
+using namespace std;
+using namespace boxedin;
+
+// Approximate size of a std::set node on 64-bit platforms: color, parent,
+// left, right and the Node* value.
+#define STD_SET_NODE_SIZE 40
+
+typedef chrono::steady_clock bench_clock;
+
+static double ns_per_op(bench_clock::time_point t1, bench_clock::time_point t2, size_t ops)
+{
+    return chrono::duration<double, nano>(t2 - t1).count() / (double)ops;
+}
+
+static vector<Node*> collect_states(const Level& level, Heuristic& heuristic, size_t max_states)
+{
+    vector<Node*> states;
+    TranspositionTable seen;
+    Node* start = Node::MakeStartNode(level, heuristic);
+    seen.Insert(start, NULL);
+    states.push_back(start);
+
+    for (size_t i = 0; i < states.size() && states.size() < max_states; i++)
+    {
+        list<Action> actions = find_actions(level, *states[i]);
+        for (list<Action>::iterator it = actions.begin(); it != actions.end(); ++it)
+        {
+            Node* successor = new Node(level, heuristic, *states[i], *it);
+            if (states.size() < max_states && seen.Find(*successor) == NULL)
+            {
+                seen.Insert(successor, NULL);
+                states.push_back(successor);
+            }
+            else
+            {
+                delete successor;
+            }
+        }
+    }
+    return states;
+}
+
+int main(int argc, char* argv[])
+{
+    string level_path = (argc > 1) ? argv[1] : "level-data/1/29.txt";
+    size_t max_states = (argc > 2) ? (size_t)atol(argv[2]) : 1000000;
+
+    vector<vector<char> > charmap;
+    ifstream level_istream(level_path.c_str());
+    boxedin::io::ParseCharMap(level_istream, charmap);
+    if (!boxedin::io::IsValidBoxedInLevel(charmap))
+    {
+        fprintf(stderr, "ERROR: Invalid boxed in level %s\n", level_path.c_str());
+        return 1;
+    }
+    Level level = Level::MakeLevel(charmap);
+    ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+
+    vector<Node*> states = collect_states(level, heuristic, max_states);
+    size_t n = states.size();
+    fmt::print("{}: {} states\n", level_path, n);
+
+    // std::set open set and closed set
+    {
+        set<Node*, NodeCompare> open_set;
+        set<Node*, NodeCompare> closed_set;
+        size_t found = 0;
+
+        bench_clock::time_point t0 = bench_clock::now();
+        for (size_t i = 0; i < n; i++)
+        {
+            if (closed_set.find(states[i]) == closed_set.end() &&
+                open_set.find(states[i]) == open_set.end())
+            {
+                open_set.insert(states[i]);
+            }
+        }
+        bench_clock::time_point t1 = bench_clock::now();
+        for (size_t i = 0; i < n; i++)
+        {
+            open_set.erase(states[i]);
+            closed_set.insert(states[i]);
+        }
+        bench_clock::time_point t2 = bench_clock::now();
+        for (size_t i = 0; i < n; i++)
+        {
+            found += (closed_set.find(states[i]) != closed_set.end());
+        }
+        bench_clock::time_point t3 = bench_clock::now();
+
+        fmt::print("std::set           insert {:7.1f} ns  close {:7.1f} ns  find {:7.1f} ns  memory {:>12} bytes ({} found)\n",
+                   ns_per_op(t0, t1, n), ns_per_op(t1, t2, n), ns_per_op(t2, t3, n),
+                   closed_set.size() * STD_SET_NODE_SIZE, found);
+    }
+
+    // TranspositionTable
+    {
+        TranspositionTable table;
+        size_t found = 0;
+
+        bench_clock::time_point t0 = bench_clock::now();
+        for (size_t i = 0; i < n; i++)
+        {
+            table.Insert(states[i], NULL);
+        }
+        bench_clock::time_point t1 = bench_clock::now();
+        for (size_t i = 0; i < n; i++)
+        {
+            table.Close(states[i]);
+        }
+        bench_clock::time_point t2 = bench_clock::now();
+        for (size_t i = 0; i < n; i++)
+        {
+            found += table.IsClosed(*states[i]);
+        }
+        bench_clock::time_point t3 = bench_clock::now();
+
+        fmt::print("TranspositionTable insert {:7.1f} ns  close {:7.1f} ns  find {:7.1f} ns  memory {:>12} bytes ({} found)\n",
+                   ns_per_op(t0, t1, n), ns_per_op(t1, t2, n), ns_per_op(t2, t3, n),
+                   table.memory_usage(), found);
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        delete states[i];
+    }
+    return 0;
+}
@@ -0,0 +1,332 @@
+/**
+ * \file Arena.cc
+ * \brief Region allocator that holds the memory of one search.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ */
+
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include <mutex>
+
+#include "Arena.h"
+
+using namespace std;
+
+namespace boxedin {
+
+namespace {
+
+#define ARENA_ALIGNMENT 16
+#define ARENA_PAGE_SIZE 4096
+
+size_t round_up(size_t n, size_t multiple)
+{
+    return (n + multiple - 1) / multiple * multiple;
+}
+
+// Address space reserved for Nodes: 1.4 billion Nodes of 48 bytes. Less is
+// reserved if the system refuses.
+#define NODE_REGION_SIZE ((size_t)64 << 30)
+
+mutex node_region_mutex;
+size_t node_region_used = 0;          // blocks handed out so far, from the start
+vector<char*> node_region_free;       // blocks given back
+
+} // anonymous namespace
+
+
+char* NodeRegion::base_ = NULL;
+size_t NodeRegion::reserved_ = 0;
+
+
+char* NodeRegion::AllocateBlock(bool huge_pages)
+{
+    lock_guard<mutex> lock(node_region_mutex);
+    if (base_ == NULL)
+    {
+        // Reserve one block more than needed so the blocks can be aligned
+        for (size_t size = NODE_REGION_SIZE; size >= 64 * NODE_BLOCK_SIZE; size /= 2)
+        {
+            void* p = mmap(NULL, size + NODE_BLOCK_SIZE, PROT_NONE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (p != MAP_FAILED)
+            {
+                base_ = (char*)round_up((uintptr_t)p, NODE_BLOCK_SIZE);
+                reserved_ = size;
+                break;
+            }
+        }
+        if (base_ == NULL)
+        {
+            throw bad_alloc();
+        }
+    }
+
+    char* block;
+    if (!node_region_free.empty())
+    {
+        block = node_region_free.back();
+        node_region_free.pop_back();
+    }
+    else if ((node_region_used + 1) * NODE_BLOCK_SIZE <= reserved_)
+    {
+        block = base_ + node_region_used * NODE_BLOCK_SIZE;
+        node_region_used++;
+    }
+    else
+    {
+        throw bad_alloc();
+    }
+    if (mprotect(block, NODE_BLOCK_SIZE, PROT_READ | PROT_WRITE) != 0)
+    {
+        throw bad_alloc();
+    }
+#ifdef MADV_HUGEPAGE
+    if (huge_pages)
+    {
+        madvise(block, NODE_BLOCK_SIZE, MADV_HUGEPAGE);
+    }
+#endif
+    return block;
+}
+
+
+void NodeRegion::FreeBlock(char* block)
+{
+    lock_guard<mutex> lock(node_region_mutex);
+    madvise(block, NODE_BLOCK_SIZE, MADV_DONTNEED);
+    mprotect(block, NODE_BLOCK_SIZE, PROT_NONE);
+    node_region_free.push_back(block);
+}
+
+
+Arena::Arena(bool huge_pages)
+    : huge_pages_(huge_pages)
+    , cursor_(NULL)
+    , limit_(NULL)
+    , mapped_(0)
+{
+    for (int i = 0; i < CATEGORY_COUNT; i++)
+    {
+        bytes_[i] = 0;
+    }
+}
+
+
+Arena::~Arena()
+{
+    for (size_t i = 0; i < blocks_.size(); i++)
+    {
+        Unmap(blocks_[i].base, blocks_[i].size);
+    }
+    for (size_t i = 0; i < large_.size(); i++)
+    {
+        Unmap(large_[i].base, large_[i].size);
+    }
+    for (size_t i = 0; i < node_blocks_.size(); i++)
+    {
+        NodeRegion::FreeBlock(node_blocks_[i]);
+    }
+}
+
+
+void* Arena::Allocate(size_t bytes, Category category)
+{
+    bytes = round_up(bytes == 0 ? 1 : bytes, ARENA_ALIGNMENT);
+    bytes_[category] += bytes;
+
+    if (bytes > ARENA_LARGE_ALLOCATION)
+    {
+        Mapping mapping;
+        mapping.size = round_up(bytes, huge_pages_ ? ARENA_BLOCK_SIZE : ARENA_PAGE_SIZE);
+        mapping.base = Map(mapping.size);
+        large_.push_back(mapping);
+        return mapping.base;
+    }
+
+    if (cursor_ == NULL || bytes > (size_t)(limit_ - cursor_))
+    {
+        Mapping block;
+        block.size = ARENA_BLOCK_SIZE;
+        block.base = Map(block.size);
+        blocks_.push_back(block);
+        cursor_ = block.base;
+        limit_ = block.base + block.size;
+    }
+    void* p = cursor_;
+    cursor_ += bytes;
+    return p;
+}
+
+
+char* Arena::AllocateNodeBlock()
+{
+    char* block = NodeRegion::AllocateBlock(huge_pages_);
+    node_blocks_.push_back(block);
+    bytes_[CATEGORY_NODES] += NODE_BLOCK_SIZE;
+    mapped_ += NODE_BLOCK_SIZE;
+    return block;
+}
+
+
+void Arena::Free(void* p, size_t bytes, Category category)
+{
+    bytes = round_up(bytes == 0 ? 1 : bytes, ARENA_ALIGNMENT);
+    if (bytes <= ARENA_LARGE_ALLOCATION)
+    {
+        return;
+    }
+    for (size_t i = 0; i < large_.size(); i++)
+    {
+        if (large_[i].base == p)
+        {
+            Unmap(large_[i].base, large_[i].size);
+            large_[i] = large_.back();
+            large_.pop_back();
+            bytes_[category] -= bytes;
+            return;
+        }
+    }
+}
+
+
+const char* Arena::CategoryName(Category category)
+{
+    switch (category)
+    {
+    case CATEGORY_NODES:
+        return "nodes";
+    case CATEGORY_TRANSPOSITION_TABLE:
+        return "transposition table";
+    case CATEGORY_OPEN_SET:
+        return "open set";
+    case CATEGORY_SUCCESSORS:
+        return "successors";
+    default:
+        return "unknown";
+    }
+}
+
+
+char* Arena::Map(size_t size)
+{
+    void* p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (huge_pages_)
+    {
+        // Fails unless huge pages have been reserved (vm.nr_hugepages)
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED)
+        {
+            mapped_ += size;
+            return (char*)p;
+        }
+    }
+#endif
+    if (!huge_pages_)
+    {
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+        {
+            throw bad_alloc();
+        }
+        mapped_ += size;
+        return (char*)p;
+    }
+
+    // Transparent huge pages need 2 MB alignment, so map one block more than
+    // needed and trim both ends.
+    size_t padded = size + ARENA_BLOCK_SIZE;
+    p = mmap(NULL, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+    {
+        throw bad_alloc();
+    }
+    char* base = (char*)p;
+    char* aligned = (char*)round_up((uintptr_t)base, ARENA_BLOCK_SIZE);
+    if (aligned > base)
+    {
+        munmap(base, aligned - base);
+    }
+    size_t tail = (base + padded) - (aligned + size);
+    if (tail > 0)
+    {
+        munmap(aligned + size, tail);
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+    mapped_ += size;
+    return aligned;
+}
+
+
+void Arena::Unmap(char* base, size_t size)
+{
+    munmap(base, size);
+    mapped_ -= size;
+}
+
+
+NodePool::NodePool(size_t node_size, Arena& arena)
+    : node_size_(round_up(node_size, sizeof(void*)))
+    , arena_(arena)
+    , free_(NULL)
+    , block_(0)
+    , cursor_(NULL)
+    , limit_(NULL)
+{
+    block_bytes_ = NODE_BLOCK_SIZE / node_size_ * node_size_;
+}
+
+
+void* NodePool::Allocate()
+{
+    if (free_)
+    {
+        FreeNode* node = free_;
+        free_ = node->next;
+        return node;
+    }
+    if (cursor_ == limit_)
+    {
+        NextBlock();
+    }
+    void* p = cursor_;
+    cursor_ += node_size_;
+    return p;
+}
+
+
+void NodePool::Free(void* p)
+{
+    FreeNode* node = (FreeNode*)p;
+    node->next = free_;
+    free_ = node;
+}
+
+
+void NodePool::Reset()
+{
+    free_ = NULL;
+    block_ = 0;
+    cursor_ = NULL;
+    limit_ = NULL;
+}
+
+
+void NodePool::NextBlock()
+{
+    if (block_ == blocks_.size())
+    {
+        blocks_.push_back(arena_.AllocateNodeBlock());
+    }
+    cursor_ = blocks_[block_++];
+    limit_ = cursor_ + block_bytes_;
+}
+
+} // namespace boxedin
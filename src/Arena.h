@@ -0,0 +1,261 @@
+/**
+ * \file Arena.h
+ * \brief Region allocator that holds the memory of one search.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ */
+#ifndef ARENA_H__
+#define ARENA_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <new>
+#include <vector>
+
+namespace boxedin
+{
+
+// Memory is mapped in blocks of this size (one x86-64 huge page)
+#define ARENA_BLOCK_SIZE ((size_t)2 << 20)
+
+// Allocations larger than this get a mapping of their own, which Free()
+// returns to the system
+#define ARENA_LARGE_ALLOCATION (ARENA_BLOCK_SIZE / 2)
+
+// Nodes are carved out of NodeRegion blocks of this size
+#define NODE_BLOCK_SIZE ARENA_BLOCK_SIZE
+
+// Index of no Node (e.g. the predecessor of the start Node)
+#define NODE_INDEX_NONE UINT32_MAX
+
+/**
+   \class NodeRegion
+   \brief The address range that every NodePool block comes from, so that
+          an object in a block can be named by a 32-bit index instead of a
+          64-bit pointer.
+
+   The range is only reserved, the first time a block is needed. A block is
+   committed when it is handed out and decommitted when it is given back.
+   Indexes mean the same thing in every thread and every search. A pointer
+   outside of the range (e.g. a Node on the stack) has no index.
+ */
+class NodeRegion
+{
+public:
+    /** \returns A block of NODE_BLOCK_SIZE bytes. Thread safe. */
+    static char* AllocateBlock(bool huge_pages);
+
+    /** Give back a block. Thread safe. */
+    static void FreeBlock(char* block);
+
+    /**
+       \returns The index of the object of size bytes at p, or
+                NODE_INDEX_NONE if p is not in the region.
+       \pre Objects of this size are laid out from the start of their block.
+     */
+    static uint32_t Index(const void* p, size_t size)
+    {
+        size_t offset = (uintptr_t)p - (uintptr_t)base_;
+        if (offset >= reserved_) // p is before or after the region
+        {
+            return NODE_INDEX_NONE;
+        }
+        return (uint32_t)((offset / NODE_BLOCK_SIZE) * (NODE_BLOCK_SIZE / size) +
+                          (offset % NODE_BLOCK_SIZE) / size);
+    }
+
+    /** \returns The object of size bytes with index. */
+    static void* At(uint32_t index, size_t size)
+    {
+        size_t per_block = NODE_BLOCK_SIZE / size;
+        return base_ + (index / per_block) * NODE_BLOCK_SIZE + (index % per_block) * size;
+    }
+
+private:
+    static char* base_;
+    static size_t reserved_;
+};
+
+/**
+   \class Arena
+   \brief Bump allocator over large mapped blocks, released all at once when
+          the Arena is destroyed.
+
+   Small allocations are carved out of the current block and are never
+   returned individually; whoever owns them recycles them (e.g. NodePool).
+   Large allocations, such as the transposition table, are mapped on their
+   own so that growing them does not leave the old copy behind.
+
+   Every allocation is tagged with a Category so that the memory a search
+   holds can be broken down by what it is used for.
+
+   An Arena is not thread safe.
+ */
+class Arena
+{
+public:
+    /** What an allocation is used for */
+    enum Category
+    {
+        CATEGORY_NODES,
+        CATEGORY_TRANSPOSITION_TABLE,
+        CATEGORY_OPEN_SET,
+        CATEGORY_SUCCESSORS,
+        CATEGORY_COUNT
+    };
+
+    /**
+       \param[in] huge_pages Back the blocks with 2 MB pages. Explicit huge
+                  pages are used if the system has some reserved, otherwise
+                  transparent huge pages are requested.
+     */
+    explicit Arena(bool huge_pages = false);
+    ~Arena();
+
+    /** \returns bytes of memory aligned to 16 bytes. Never NULL. */
+    void* Allocate(size_t bytes, Category category);
+
+    /**
+       \brief Give back an allocation. Only large allocations are unmapped;
+              small ones stay in their block until the Arena is destroyed.
+     */
+    void Free(void* p, size_t bytes, Category category);
+
+    /**
+       \brief Take a block from the NodeRegion for a NodePool. It is counted
+              as CATEGORY_NODES and given back when the Arena is destroyed.
+     */
+    char* AllocateNodeBlock();
+
+    /** \returns Bytes held for category, including freed small allocations. */
+    size_t bytes(Category category) const { return bytes_[category]; }
+
+    /** \returns Bytes mapped from the system, including unused block space. */
+    size_t mapped() const { return mapped_; }
+
+    bool huge_pages() const { return huge_pages_; }
+
+    static const char* CategoryName(Category category);
+
+private:
+    struct Mapping
+    {
+        char* base;
+        size_t size;
+    };
+
+    char* Map(size_t size);
+    void Unmap(char* base, size_t size);
+
+    bool huge_pages_;
+    std::vector<Mapping> blocks_;
+    std::vector<Mapping> large_;
+    std::vector<char*> node_blocks_;
+    char* cursor_; // next free byte of the current block
+    char* limit_;  // end of the current block
+    size_t bytes_[CATEGORY_COUNT];
+    size_t mapped_;
+
+    Arena(const Arena& other); // no copy
+    Arena& operator=(const Arena& other); // no copy
+};
+
+
+/**
+   \class ArenaAllocator
+   \brief STL allocator that takes memory from an Arena, or from the heap if
+          it has none.
+ */
+template <class T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(Arena* arena = NULL,
+                            Arena::Category category = Arena::CATEGORY_SUCCESSORS)
+        : arena_(arena)
+        , category_(category)
+    {
+    }
+
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U>& other)
+        : arena_(other.arena_)
+        , category_(other.category_)
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        if (arena_ == NULL)
+        {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+        return static_cast<T*>(arena_->Allocate(n * sizeof(T), category_));
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        if (arena_ == NULL)
+        {
+            ::operator delete(p);
+            return;
+        }
+        arena_->Free(p, n * sizeof(T), category_);
+    }
+
+    bool operator==(const ArenaAllocator& other) const { return arena_ == other.arena_; }
+    bool operator!=(const ArenaAllocator& other) const { return arena_ != other.arena_; }
+
+    Arena* arena_;
+    Arena::Category category_;
+};
+
+
+/**
+   \class NodePool
+   \brief Fixed-size allocator for Nodes. Blocks come from the NodeRegion
+          through an Arena and freed Nodes are kept on a free list for reuse.
+
+   Nodes are laid out from the start of each block, so NodeRegion::Index()
+   and NodeRegion::At() convert between a Node and its index.
+ */
+class NodePool
+{
+public:
+    NodePool(size_t node_size, Arena& arena);
+
+    void* Allocate();
+    void Free(void* p);
+
+    /** Forget every Node and start again from the first block. */
+    void Reset();
+
+private:
+    // A freed Node is reused as a link in the free list
+    struct FreeNode
+    {
+        FreeNode* next;
+    };
+
+    void NextBlock();
+
+    size_t node_size_;
+    size_t block_bytes_; // bytes of a block that hold whole Nodes
+    Arena& arena_;
+    FreeNode* free_;
+    std::vector<char*> blocks_;
+    size_t block_; // index of the block being carved
+    char* cursor_;
+    char* limit_;
+
+    NodePool(const NodePool& other); // no copy
+    NodePool& operator=(const NodePool& other); // no copy
+};
+
+} // namespace boxedin
+
+#endif
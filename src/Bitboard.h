@@ -0,0 +1,278 @@
+/**
+ * \file Bitboard.h
+ * \brief Sets of level tiles stored one bit per tile.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ */
+#ifndef BITBOARD_H__
+#define BITBOARD_H__
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "boxedintypes.h"
+
+namespace boxedin
+{
+
+// Number of 64-bit words in a Bitboard. Same layout as the box bitfields of
+// BoxDescriptorLite: bit (tile % 64) of word (tile / 64), tile = y*width + x.
+#define BITBOARD_WORDS BOARD_WORDS
+#define BITBOARD_TILES (BITBOARD_WORDS * 64)
+
+/**
+   \struct Bitboard
+   \brief A set of tiles. Set operations work on all tiles at once.
+ */
+struct Bitboard
+{
+    uint64_t words[BITBOARD_WORDS];
+
+    Bitboard()
+    {
+        for (int i = 0; i < BITBOARD_WORDS; i++)
+        {
+            words[i] = 0;
+        }
+    }
+
+    explicit Bitboard(const uint64_t* bitfields)
+    {
+        for (int i = 0; i < BITBOARD_WORDS; i++)
+        {
+            words[i] = bitfields[i];
+        }
+    }
+
+    static Bitboard Tile(int tile)
+    {
+        Bitboard b;
+        b.Set(tile);
+        return b;
+    }
+
+    void Set(int tile) { words[tile >> 6] |= (uint64_t)1 << (tile & 63); }
+    void Clear(int tile) { words[tile >> 6] &= ~((uint64_t)1 << (tile & 63)); }
+    bool Test(int tile) const { return (words[tile >> 6] >> (tile & 63)) & 1; }
+
+    bool Any() const
+    {
+        uint64_t any = 0;
+        for (int i = 0; i < BITBOARD_WORDS; i++)
+        {
+            any |= words[i];
+        }
+        return any != 0;
+    }
+
+    int Count() const
+    {
+        int count = 0;
+        for (int i = 0; i < BITBOARD_WORDS; i++)
+        {
+            count += __builtin_popcountll(words[i]);
+        }
+        return count;
+    }
+
+    /** \returns The tile of lowest index, or -1 if the set is empty. */
+    int First() const
+    {
+        for (int i = 0; i < BITBOARD_WORDS; i++)
+        {
+            if (words[i])
+            {
+                return i * 64 + __builtin_ctzll(words[i]);
+            }
+        }
+        return -1;
+    }
+
+    /** Move every tile n (0 < n < 64) tiles forward (toward higher indexes). */
+    Bitboard ShiftForward(int n) const
+    {
+        Bitboard b;
+        for (int i = BITBOARD_WORDS - 1; i > 0; i--)
+        {
+            b.words[i] = (words[i] << n) | (words[i - 1] >> (64 - n));
+        }
+        b.words[0] = words[0] << n;
+        return b;
+    }
+
+    /** Move every tile n (0 < n < 64) tiles back (toward lower indexes). */
+    Bitboard ShiftBack(int n) const
+    {
+        Bitboard b;
+        for (int i = 0; i < BITBOARD_WORDS - 1; i++)
+        {
+            b.words[i] = (words[i] >> n) | (words[i + 1] << (64 - n));
+        }
+        b.words[BITBOARD_WORDS - 1] = words[BITBOARD_WORDS - 1] >> n;
+        return b;
+    }
+
+    Bitboard operator|(const Bitboard& o) const
+    {
+        Bitboard b;
+        for (int i = 0; i < BITBOARD_WORDS; i++)
+        {
+            b.words[i] = words[i] | o.words[i];
+        }
+        return b;
+    }
+
+    Bitboard operator&(const Bitboard& o) const
+    {
+        Bitboard b;
+        for (int i = 0; i < BITBOARD_WORDS; i++)
+        {
+            b.words[i] = words[i] & o.words[i];
+        }
+        return b;
+    }
+
+    Bitboard operator~() const
+    {
+        Bitboard b;
+        for (int i = 0; i < BITBOARD_WORDS; i++)
+        {
+            b.words[i] = ~words[i];
+        }
+        return b;
+    }
+
+    Bitboard& operator|=(const Bitboard& o)
+    {
+        for (int i = 0; i < BITBOARD_WORDS; i++)
+        {
+            words[i] |= o.words[i];
+        }
+        return *this;
+    }
+
+    Bitboard& operator&=(const Bitboard& o)
+    {
+        for (int i = 0; i < BITBOARD_WORDS; i++)
+        {
+            words[i] &= o.words[i];
+        }
+        return *this;
+    }
+
+    /** \returns this minus o */
+    Bitboard AndNot(const Bitboard& o) const
+    {
+        Bitboard b;
+        for (int i = 0; i < BITBOARD_WORDS; i++)
+        {
+            b.words[i] = words[i] & ~o.words[i];
+        }
+        return b;
+    }
+
+    bool operator==(const Bitboard& o) const
+    {
+        for (int i = 0; i < BITBOARD_WORDS; i++)
+        {
+            if (words[i] != o.words[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+
+/**
+   \struct LevelBitboards
+   \brief The parts of a Level that never change, as Bitboards, plus the
+          shifts that move a set of tiles one step in each direction.
+
+   The shifts drop tiles that would leave the level instead of wrapping them
+   to the next row. The level must have fewer than 64 columns and at most
+   BITBOARD_TILES tiles.
+ */
+struct LevelBitboards
+{
+    int width;
+    int tiles;
+
+    Bitboard board;            // every tile of the level
+    Bitboard floor;            // tiles that are floor in the floor plan
+    Bitboard boxing;           // spaces and walls; they box in a tile like a box does
+    Bitboard not_left_column;  // every tile except column 0
+    Bitboard not_right_column; // every tile except the last column
+    Bitboard edge[4];          // first row, last row, first column, last column
+    Bitboard exit;
+
+    // gears[i] is the tile of gear i (GearDescriptorLite bit i)
+    std::vector<Bitboard> gears;
+
+    // Switch and gate tile of each color in the level
+    std::vector<Bitboard> switches;
+    std::vector<Bitboard> gates;
+
+    // Floor tiles that split the floor in two (articulation points)
+    Bitboard articulation;
+
+    // Tiles where a box pushed in direction d (an EncodedPathDirection)
+    // walls the player off from the exit for good: an articulation point,
+    // with no push of the box from the side the player is left on. Other
+    // boxes are ignored and gates are taken as open, so the walls are all
+    // that is left.
+    Bitboard cuts_exit[4];
+
+    // Likewise, the gears a box pushed onto tile t in direction d walls the
+    // player off from: cut_gears[t * 4 + d].
+    std::vector<gears_bitfield_t> cut_gears;
+
+    // Tiles where a box pushed in direction d leaves the player in a dead
+    // end, whose only way out is through the box and which holds no exit,
+    // gear, switch or gate. Unless there is a box in the dead end
+    // (tunnel_behind[t * 4 + d]), all the player can do is push the box on.
+    Bitboard tunnel[4];
+    std::vector<Bitboard> tunnel_behind;
+
+    LevelBitboards() : width(0), tiles(0) {}
+
+    int TileIndex(const Coord& coord) const { return (int)coord.y * width + coord.x; }
+    Coord TileCoord(int tile) const { return Coord(tile % width, tile / width); }
+
+    /** \returns The tiles one step up from the tiles of b */
+    Bitboard Up(const Bitboard& b) const
+    {
+        return b.ShiftBack(width);
+    }
+
+    /** \returns The tiles one step down from the tiles of b */
+    Bitboard Down(const Bitboard& b) const
+    {
+        return b.ShiftForward(width) & board;
+    }
+
+    /** \returns The tiles one step left from the tiles of b */
+    Bitboard Left(const Bitboard& b) const
+    {
+        return (b & not_left_column).ShiftBack(1);
+    }
+
+    /** \returns The tiles one step right from the tiles of b */
+    Bitboard Right(const Bitboard& b) const
+    {
+        return (b & not_right_column).ShiftForward(1);
+    }
+
+    /** \returns The tiles next to the tiles of b */
+    Bitboard Neighbors(const Bitboard& b) const
+    {
+        return Up(b) | Down(b) | Left(b) | Right(b);
+    }
+};
+
+} // namespace boxedin
+
+#endif
@@ -0,0 +1,407 @@
+/**
+ * \file BucketQueue.h
+ * \brief Open set priority queue of Nodes indexed by fscore, then hscore.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ */
+#ifndef BUCKET_QUEUE_H__
+#define BUCKET_QUEUE_H__
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "Arena.h"
+#include "boxedintypes.h"
+#include "config.h"
+#include "Node.h"
+
+namespace boxedin
+{
+
+/**
+   \class BucketQueue
+   \brief Two-level bucket queue of Nodes: the first index is the priority
+          and the second index is the hscore.
+
+   The priority is the fscore unless the caller supplies another one (e.g.
+   the inflated fscore of weighted A*). Among Nodes with the same priority,
+   the TieBreaking policy decides which comes out first. Preferring a low
+   hscore (high gscore) and the newest Node makes A* dive toward the goal in
+   the last fscore layer instead of sweeping it breadth first.
+
+   Each bucket is a list of fixed-size chunks of Node pointers. Chunks are
+   recycled through a free list, so Push() and Pop() do not allocate in the
+   steady state. They come from the Arena given to the constructor, or from
+   the heap if there is none. Both are constant time because priorities and hscores are
+   small integers.
+
+   The queue stores the position of each Node in Node::open_handle_, so
+   Remove() is constant time as well. A search that reaches an open state
+   with a better gscore removes the old Node instead of leaving it behind.
+ */
+class BucketQueue
+{
+public:
+    /** Order of Nodes that have the same priority */
+    enum TieBreaking
+    {
+        TIE_BREAK_FIFO,       /**< oldest first */
+        TIE_BREAK_LIFO,       /**< newest first */
+        TIE_BREAK_LOW_H_FIFO, /**< lowest hscore, then oldest first */
+        TIE_BREAK_LOW_H_LIFO  /**< lowest hscore, then newest first */
+    };
+
+    explicit BucketQueue(cost_t max_priority = MAX_FSCORE,
+                         TieBreaking tie_breaking = TIE_BREAK_LOW_H_LIFO,
+                         Arena* arena = NULL)
+        : arena_(arena)
+        , buckets_(max_priority)
+        , max_priority_(max_priority)
+        , min_priority_(max_priority)
+        , size_(0)
+        , tie_breaking_(tie_breaking)
+    {
+    }
+
+    // Does not touch the Nodes; they may already be gone
+    ~BucketQueue()
+    {
+        if (arena_)
+        {
+            return; // the Arena releases the chunks
+        }
+        for (size_t p = 0; p < buckets_.size(); p++)
+        {
+            for (size_t h = 0; h < buckets_[p].by_h.size(); h++)
+            {
+                const NodeList& nodes = buckets_[p].by_h[h];
+                for (size_t c = 0; c < nodes.chunks.size(); c++)
+                {
+                    delete nodes.chunks[c];
+                }
+            }
+        }
+        for (size_t i = 0; i < free_chunks_.size(); i++)
+        {
+            delete free_chunks_[i];
+        }
+    }
+
+    /** \pre node->fscore() < max_priority() */
+    void Push(Node* node)
+    {
+        Push(node, node->fscore());
+    }
+
+    /** \pre priority < max_priority() */
+    void Push(Node* node, cost_t priority)
+    {
+        PriorityBucket& bucket = buckets_[priority];
+        size_t h = by_hscore() ? (size_t)node->hscore_ : 0;
+        if (h >= bucket.by_h.size())
+        {
+            bucket.by_h.resize(h + 1);
+        }
+        PushBack(bucket.by_h[h], node);
+        if (h < bucket.min_h)
+        {
+            bucket.min_h = h;
+        }
+        bucket.size++;
+        if (priority < min_priority_)
+        {
+            min_priority_ = priority;
+        }
+        size_++;
+    }
+
+    /** \returns The next Node with the lowest priority, or NULL if empty. */
+    Node* Pop()
+    {
+        if (MinPriority() == max_priority_)
+        {
+            return NULL;
+        }
+        PriorityBucket& bucket = buckets_[min_priority_];
+        while (bucket.by_h[bucket.min_h].empty())
+        {
+            bucket.min_h++;
+        }
+        NodeList& nodes = bucket.by_h[bucket.min_h];
+        Node* node = lifo() ? PopBack(nodes) : PopFront(nodes);
+        node->open_handle_ = NODE_NOT_QUEUED;
+        if (--bucket.size == 0)
+        {
+            bucket.min_h = (size_t)-1;
+        }
+        size_--;
+        return node;
+    }
+
+    /** Remove node, which was pushed with its fscore as the priority. */
+    void Remove(Node* node)
+    {
+        Remove(node, node->fscore());
+    }
+
+    /**
+       \brief Remove node from the queue without deleting it.
+       \pre node is in this queue and was pushed with priority. Its hscore
+            has not changed since.
+     */
+    void Remove(Node* node, cost_t priority)
+    {
+        PriorityBucket& bucket = buckets_[priority];
+        NodeList& nodes = bucket.by_h[by_hscore() ? (size_t)node->hscore_ : 0];
+        size_t index = node->open_handle_;
+        // Fill the hole with the last Node of the list
+        Node* last = PopBack(nodes);
+        if (last != node)
+        {
+            Slot(nodes, index) = last;
+            last->open_handle_ = (uint32_t)index;
+        }
+        node->open_handle_ = NODE_NOT_QUEUED;
+        if (--bucket.size == 0)
+        {
+            bucket.min_h = (size_t)-1;
+        }
+        size_--;
+    }
+
+    /**
+       \returns true if node is in a BucketQueue. Nodes are only ever in one
+                queue at a time.
+     */
+    static bool IsQueued(const Node* node)
+    {
+        return node->open_handle_ != NODE_NOT_QUEUED;
+    }
+
+    /** \returns The lowest priority in the queue, or max_priority() if empty. */
+    cost_t MinPriority()
+    {
+        while (min_priority_ < max_priority_ && buckets_[min_priority_].size == 0)
+        {
+            min_priority_++;
+        }
+        return min_priority_;
+    }
+
+    /**
+       \returns The lowest fscore of the Nodes in the queue, or COST_INFINITY
+                if the queue is empty.
+       \details Visits every Node, so it is meant to be called rarely (e.g.
+                once per weighted A* iteration).
+     */
+    cost_t LowestFscore() const
+    {
+        cost_t lowest = COST_INFINITY;
+        for (size_t p = 0; p < buckets_.size(); p++)
+        {
+            const PriorityBucket& bucket = buckets_[p];
+            for (size_t h = 0; h < bucket.by_h.size(); h++)
+            {
+                const NodeList& nodes = bucket.by_h[h];
+                for (size_t i = nodes.head; i < nodes.tail; i++)
+                {
+                    const Node* node = Slot(nodes, i);
+                    if (node->fscore() < lowest)
+                    {
+                        lowest = node->fscore();
+                    }
+                }
+            }
+        }
+        return lowest;
+    }
+
+    /** Remove every Node without deleting it. */
+    void Clear()
+    {
+        for (size_t p = 0; p < buckets_.size(); p++)
+        {
+            PriorityBucket& bucket = buckets_[p];
+            for (size_t h = 0; h < bucket.by_h.size(); h++)
+            {
+                NodeList& nodes = bucket.by_h[h];
+                for (size_t i = nodes.head; i < nodes.tail; i++)
+                {
+                    Slot(nodes, i)->open_handle_ = NODE_NOT_QUEUED;
+                }
+                for (size_t c = 0; c < nodes.chunks.size(); c++)
+                {
+                    free_chunks_.push_back(nodes.chunks[c]);
+                }
+                nodes = NodeList();
+            }
+            bucket.size = 0;
+            bucket.min_h = (size_t)-1;
+        }
+        min_priority_ = max_priority_;
+        size_ = 0;
+    }
+
+    /** \pre The queue is empty. */
+    void SetTieBreaking(TieBreaking tie_breaking) { tie_breaking_ = tie_breaking; }
+
+    void swap(BucketQueue& other)
+    {
+        std::swap(arena_, other.arena_);
+        buckets_.swap(other.buckets_);
+        free_chunks_.swap(other.free_chunks_);
+        std::swap(max_priority_, other.max_priority_);
+        std::swap(min_priority_, other.min_priority_);
+        std::swap(size_, other.size_);
+        std::swap(tie_breaking_, other.tie_breaking_);
+    }
+
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+    cost_t max_priority() const { return max_priority_; }
+    TieBreaking tie_breaking() const { return tie_breaking_; }
+
+private:
+    static const size_t kChunkSize = 256;
+
+    struct Chunk
+    {
+        Node* nodes[kChunkSize];
+    };
+
+    // Nodes with the same priority and hscore. Positions only grow while
+    // the list has Nodes, so the position of a Node stays valid when Nodes
+    // before it are popped. chunks[0] starts at position base.
+    struct NodeList
+    {
+        std::vector<Chunk*> chunks;
+        size_t base;
+        size_t head; // position of the first Node
+        size_t tail; // position after the last Node
+
+        NodeList() : base(0), head(0), tail(0) {}
+
+        bool empty() const { return head == tail; }
+    };
+
+    struct PriorityBucket
+    {
+        std::vector<NodeList> by_h;
+        size_t min_h; // no NodeList below this index has a Node
+        size_t size;
+
+        PriorityBucket() : min_h((size_t)-1), size(0) {}
+    };
+
+    bool by_hscore() const
+    {
+        return tie_breaking_ == TIE_BREAK_LOW_H_FIFO || tie_breaking_ == TIE_BREAK_LOW_H_LIFO;
+    }
+
+    bool lifo() const
+    {
+        return tie_breaking_ == TIE_BREAK_LIFO || tie_breaking_ == TIE_BREAK_LOW_H_LIFO;
+    }
+
+    static Node*& Slot(NodeList& nodes, size_t position)
+    {
+        size_t offset = position - nodes.base;
+        return nodes.chunks[offset / kChunkSize]->nodes[offset % kChunkSize];
+    }
+
+    static Node* Slot(const NodeList& nodes, size_t position)
+    {
+        size_t offset = position - nodes.base;
+        return nodes.chunks[offset / kChunkSize]->nodes[offset % kChunkSize];
+    }
+
+    void PushBack(NodeList& nodes, Node* node)
+    {
+        if (nodes.tail - nodes.base == nodes.chunks.size() * kChunkSize)
+        {
+            nodes.chunks.push_back(NewChunk());
+        }
+        Slot(nodes, nodes.tail) = node;
+        node->open_handle_ = (uint32_t)nodes.tail;
+        nodes.tail++;
+    }
+
+    Node* PopBack(NodeList& nodes)
+    {
+        nodes.tail--;
+        Node* node = Slot(nodes, nodes.tail);
+        if (nodes.empty())
+        {
+            Reset(nodes);
+        }
+        // The last chunk is empty now; give it back to free_chunks_. An
+        // emptied list keeps its first chunk (see Reset()).
+        else if ((nodes.tail - nodes.base) % kChunkSize == 0)
+        {
+            free_chunks_.push_back(nodes.chunks.back());
+            nodes.chunks.pop_back();
+        }
+        return node;
+    }
+
+    Node* PopFront(NodeList& nodes)
+    {
+        Node* node = Slot(nodes, nodes.head);
+        nodes.head++;
+        if (nodes.empty())
+        {
+            Reset(nodes);
+        }
+        else if (nodes.head - nodes.base == kChunkSize)
+        {
+            free_chunks_.push_back(nodes.chunks.front());
+            nodes.chunks.erase(nodes.chunks.begin());
+            nodes.base += kChunkSize;
+        }
+        return node;
+    }
+
+    // Start the positions of an empty list over, keeping one chunk
+    void Reset(NodeList& nodes)
+    {
+        while (nodes.chunks.size() > 1)
+        {
+            free_chunks_.push_back(nodes.chunks.back());
+            nodes.chunks.pop_back();
+        }
+        nodes.base = nodes.head = nodes.tail = 0;
+    }
+
+    Chunk* NewChunk()
+    {
+        if (free_chunks_.empty())
+        {
+            if (arena_)
+            {
+                return new (arena_->Allocate(sizeof(Chunk), Arena::CATEGORY_OPEN_SET)) Chunk;
+            }
+            return new Chunk;
+        }
+        Chunk* chunk = free_chunks_.back();
+        free_chunks_.pop_back();
+        return chunk;
+    }
+
+    Arena* arena_;
+    std::vector<PriorityBucket> buckets_;
+    std::vector<Chunk*> free_chunks_;
+    cost_t max_priority_;
+    cost_t min_priority_;
+    size_t size_;
+    TieBreaking tie_breaking_;
+
+    BucketQueue(const BucketQueue& other); // no copy
+    BucketQueue& operator=(const BucketQueue& other); // no copy
+};
+
+} // namespace boxedin
+
+#endif
@@ -0,0 +1,537 @@
+/**
+ * \file DeadlockPatterns.cc
+ * \brief Box arrangements that the search has proved dead, kept so that
+ *        they are not proved again.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "DeadlockPatterns.h"
+
+using namespace std;
+
+namespace boxedin {
+
+namespace {
+
+// Steps in the order of EncodedPathDirection
+const int dx[4] = { 0, 1, 0, -1 };
+const int dy[4] = { -1, 0, 1, 0 };
+
+/**
+   \returns cells, width by height, turned and flipped by one of the 8
+            symmetries of a square (0 is the identity). Sets the width and
+            height of the result.
+ */
+string transform(int width, int height, const string& cells, int symmetry,
+                 int* out_width, int* out_height)
+{
+    bool transpose = symmetry & 4;
+    int w = transpose ? height : width;
+    int h = transpose ? width : height;
+    string out(w * h, '?');
+    for (int y = 0; y < h; y++)
+    {
+        for (int x = 0; x < w; x++)
+        {
+            int sx = transpose ? y : x;
+            int sy = transpose ? x : y;
+            if (symmetry & 1)
+            {
+                sx = width - 1 - sx;
+            }
+            if (symmetry & 2)
+            {
+                sy = height - 1 - sy;
+            }
+            out[y * w + x] = cells[sy * width + sx];
+        }
+    }
+    *out_width = w;
+    *out_height = h;
+    return out;
+}
+
+string format(int width, int height, const string& cells)
+{
+    ostringstream out;
+    out << width << " " << height << " ";
+    for (int y = 0; y < height; y++)
+    {
+        if (y > 0)
+        {
+            out << "/";
+        }
+        out << cells.substr(y * width, width);
+    }
+    return out.str();
+}
+
+// Drops the rows and columns of cells that are all '?'
+string trim(int* width, int* height, const string& cells)
+{
+    int x0 = *width, x1 = -1, y0 = *height, y1 = -1;
+    for (int i = 0; i < *width * *height; i++)
+    {
+        if (cells[i] != '?')
+        {
+            x0 = min(x0, i % *width);
+            x1 = max(x1, i % *width);
+            y0 = min(y0, i / *width);
+            y1 = max(y1, i / *width);
+        }
+    }
+    string out;
+    for (int y = y0; y <= y1; y++)
+    {
+        out += cells.substr(y * *width + x0, x1 - x0 + 1);
+    }
+    *width = x1 - x0 + 1;
+    *height = y1 - y0 + 1;
+    return out;
+}
+
+// Parses a pattern. Returns false if it is not valid.
+bool parse(const string& pattern, int* width, int* height, string* cells)
+{
+    istringstream in(pattern);
+    string rows;
+    if (!(in >> *width >> *height >> rows))
+    {
+        return false;
+    }
+    if (*width < 1 || *width > DEADLOCK_PATTERN_SIZE_MAX + 2 ||
+        *height < 1 || *height > DEADLOCK_PATTERN_SIZE_MAX + 2 ||
+        (int)rows.size() != *width * *height + *height - 1)
+    {
+        return false;
+    }
+    cells->clear();
+    bool box = false;
+    bool target = false;
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        char c = rows[i];
+        if ((int)(i % (*width + 1)) == *width)
+        {
+            if (c != '/')
+            {
+                return false;
+            }
+            continue;
+        }
+        if (c != 'x' && c != '+' && c != '*' && c != '@' && c != '.' && c != '?')
+        {
+            return false;
+        }
+        box = box || c == '+';
+        target = target || c == '*' || c == '@';
+        cells->push_back(c);
+    }
+    return box && target;
+}
+
+} // anonymous namespace
+
+
+DeadlockPatterns::DeadlockPatterns(const Level& level)
+    : bb_(level.bitboards_)
+    , height_(level.bitboards_.tiles / level.bitboards_.width)
+    , by_tile_(level.bitboards_.tiles)
+    , learned_(0)
+    , hits_(0)
+{
+    for (size_t i = 0; i < bb_.gates.size(); i++)
+    {
+        gates_ |= bb_.gates[i];
+    }
+}
+
+
+bool DeadlockPatterns::IsDeadPush(const Node& node, const ActionPoint& action)
+{
+    int box = bb_.TileIndex(action.point);
+    if (!((node.box_descriptor_.bitfields[box >> 6] >> (box & 63)) & 1))
+    {
+        return false;
+    }
+    const int offsets[4] = { -bb_.width, 1, bb_.width, -1 };
+    int to = box + offsets[action.direction];
+    Bitboard boxes(node.box_descriptor_.bitfields);
+    boxes.Clear(box);
+    boxes.Set(to);
+
+    // The player is left where the box was
+    const vector<uint32_t>& candidates = by_tile_[to];
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        const Instance& instance = instances_[candidates[i]];
+        if ((instance.exit || (instance.gears & node.gear_descriptor_.bitfield)) &&
+            !instance.pocket.Test(box) &&
+            (instance.boxes & boxes) == instance.boxes)
+        {
+            hits_++;
+            return true;
+        }
+    }
+    return Learn(node, box, to, boxes);
+}
+
+
+bool DeadlockPatterns::Blocks(int x, int y, const Bitboard& solid) const
+{
+    if (x < 0 || x >= bb_.width || y < 0 || y >= height_)
+    {
+        return true;
+    }
+    int tile = y * bb_.width + x;
+    return bb_.boxing.Test(tile) || solid.Test(tile);
+}
+
+
+bool DeadlockPatterns::Learn(const Node& node, int player, int box, const Bitboard& boxes)
+{
+    const int w = bb_.width;
+
+    // A box under a gate may be hidden, so it freezes nothing
+    Bitboard frozen = boxes.AndNot(gates_);
+    if (!(Blocks(box % w - 1, box / w, frozen) || Blocks(box % w + 1, box / w, frozen)) ||
+        !(Blocks(box % w, box / w - 1, frozen) || Blocks(box % w, box / w + 1, frozen)))
+    {
+        return false;
+    }
+
+    // Take away the boxes that are free along an axis until none are left.
+    // What is left can never move: each box waits on another one.
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        Bitboard left = frozen;
+        for (int tile = left.First(); tile >= 0; left.Clear(tile), tile = left.First())
+        {
+            int x = tile % w;
+            int y = tile / w;
+            if (!(Blocks(x - 1, y, frozen) || Blocks(x + 1, y, frozen)) ||
+                !(Blocks(x, y - 1, frozen) || Blocks(x, y + 1, frozen)))
+            {
+                frozen.Clear(tile);
+                changed = true;
+            }
+        }
+    }
+    if (!frozen.Test(box))
+    {
+        return false;
+    }
+
+    // The frozen boxes that touch the pushed box, side by side or corner to
+    // corner. Two boxes that only touch at a corner still wall in the floor
+    // between them.
+    Bitboard cluster = Bitboard::Tile(box);
+    vector<int> stack(1, box);
+    int x0 = box % w, x1 = x0, y0 = box / w, y1 = y0;
+    while (!stack.empty())
+    {
+        int tile = stack.back();
+        stack.pop_back();
+        for (int d = 0; d < 9; d++)
+        {
+            int x = tile % w + d % 3 - 1;
+            int y = tile / w + d / 3 - 1;
+            if (x < 0 || x >= w || y < 0 || y >= height_)
+            {
+                continue;
+            }
+            int next = y * w + x;
+            if (frozen.Test(next) && !cluster.Test(next))
+            {
+                cluster.Set(next);
+                stack.push_back(next);
+                x0 = min(x0, x);
+                x1 = max(x1, x);
+                y0 = min(y0, y);
+                y1 = max(y1, y);
+            }
+        }
+    }
+    if (x1 - x0 >= DEADLOCK_PATTERN_SIZE_MAX || y1 - y0 >= DEADLOCK_PATTERN_SIZE_MAX)
+    {
+        return false;
+    }
+
+    Bitboard targets = bb_.exit;
+    for (size_t i = 0; i < bb_.gears.size(); i++)
+    {
+        if (node.gear_descriptor_.bitfield & ((gears_bitfield_t)1 << i))
+        {
+            targets |= bb_.gears[i];
+        }
+    }
+
+    // Flood the floor next to the cluster. A pocket that the flood cannot
+    // leave, without the player and with a target, is never reached.
+    Bitboard seen;
+    Bitboard seeds = bb_.Neighbors(cluster).AndNot(bb_.boxing | cluster);
+    for (int seed = seeds.First(); seed >= 0; seeds.Clear(seed), seed = seeds.First())
+    {
+        if (seen.Test(seed))
+        {
+            continue;
+        }
+        Bitboard pocket = Bitboard::Tile(seed);
+        int px0 = x0, px1 = x1, py0 = y0, py1 = y1;
+        bool enclosed = true;
+        stack.assign(1, seed);
+        while (!stack.empty())
+        {
+            int tile = stack.back();
+            stack.pop_back();
+            px0 = min(px0, tile % w);
+            px1 = max(px1, tile % w);
+            py0 = min(py0, tile / w);
+            py1 = max(py1, tile / w);
+            if (tile == player ||
+                px1 - px0 >= DEADLOCK_PATTERN_SIZE_MAX ||
+                py1 - py0 >= DEADLOCK_PATTERN_SIZE_MAX)
+            {
+                enclosed = false;
+                break;
+            }
+            for (int d = 0; d < 4; d++)
+            {
+                int x = tile % w + dx[d];
+                int y = tile / w + dy[d];
+                if (x < 0 || x >= w || y < 0 || y >= height_)
+                {
+                    continue;
+                }
+                int next = y * w + x;
+                if (!bb_.boxing.Test(next) && !cluster.Test(next) && !pocket.Test(next))
+                {
+                    pocket.Set(next);
+                    stack.push_back(next);
+                }
+            }
+        }
+        seen |= pocket;
+        if (!enclosed || !(pocket & targets).Any())
+        {
+            continue;
+        }
+
+        // The cluster, the pocket and the walls around them
+        int width = px1 - px0 + 3;
+        int height = py1 - py0 + 3;
+        string cells(width * height, '?');
+        Bitboard inside = cluster | pocket;
+        for (int cy = 0; cy < height; cy++)
+        {
+            for (int cx = 0; cx < width; cx++)
+            {
+                int x = px0 - 1 + cx;
+                int y = py0 - 1 + cy;
+                bool on = x >= 0 && x < w && y >= 0 && y < height_;
+                int tile = y * w + x;
+                char& c = cells[cy * width + cx];
+                if (on && cluster.Test(tile))
+                {
+                    c = '+';
+                }
+                else if (on && pocket.Test(tile))
+                {
+                    c = !targets.Test(tile) ? '.' : bb_.exit.Test(tile) ? '@' : '*';
+                }
+                else if (!on || bb_.boxing.Test(tile))
+                {
+                    for (int d = 0; d < 4; d++)
+                    {
+                        int nx = x + dx[d];
+                        int ny = y + dy[d];
+                        if (nx >= 0 && nx < w && ny >= 0 && ny < height_ &&
+                            inside.Test(ny * w + nx))
+                        {
+                            c = 'x';
+                        }
+                    }
+                }
+            }
+        }
+        Add(format(width, height, cells));
+        learned_++;
+        return true;
+    }
+    return false;
+}
+
+
+bool DeadlockPatterns::Add(const string& pattern)
+{
+    int width;
+    int height;
+    string cells;
+    if (!parse(pattern, &width, &height, &cells))
+    {
+        return false;
+    }
+    cells = trim(&width, &height, cells);
+
+    // The same pattern turned or flipped is stored once
+    string canonical;
+    for (int symmetry = 0; symmetry < 8; symmetry++)
+    {
+        int w;
+        int h;
+        string turned = transform(width, height, cells, symmetry, &w, &h);
+        turned = format(w, h, turned);
+        if (symmetry == 0 || turned < canonical)
+        {
+            canonical = turned;
+        }
+    }
+    if (patterns_.insert(canonical).second)
+    {
+        Instantiate(width, height, cells);
+    }
+    return true;
+}
+
+
+void DeadlockPatterns::Instantiate(int width, int height, const string& cells)
+{
+    const int w = bb_.width;
+    for (int symmetry = 0; symmetry < 8; symmetry++)
+    {
+        int tw;
+        int th;
+        string turned = transform(width, height, cells, symmetry, &tw, &th);
+        for (int oy = 1 - th; oy < height_; oy++)
+        {
+            for (int ox = 1 - tw; ox < w; ox++)
+            {
+                Instance instance;
+                instance.gears = 0;
+                instance.exit = false;
+                bool match = true;
+                for (int i = 0; i < tw * th && match; i++)
+                {
+                    char c = turned[i];
+                    int x = ox + i % tw;
+                    int y = oy + i / tw;
+                    bool on = x >= 0 && x < w && y >= 0 && y < height_;
+                    int tile = y * w + x;
+                    if (c == '?')
+                    {
+                        continue;
+                    }
+                    if (c == 'x')
+                    {
+                        match = !on || bb_.boxing.Test(tile);
+                        continue;
+                    }
+                    if (!on)
+                    {
+                        match = false;
+                        continue;
+                    }
+                    switch (c)
+                    {
+                    case '+':
+                        match = bb_.floor.Test(tile) && !gates_.Test(tile);
+                        instance.boxes.Set(tile);
+                        break;
+                    case '*':
+                        match = false;
+                        for (size_t g = 0; g < bb_.gears.size(); g++)
+                        {
+                            if (bb_.gears[g].Test(tile))
+                            {
+                                instance.gears |= (gears_bitfield_t)1 << g;
+                                match = true;
+                            }
+                        }
+                        instance.pocket.Set(tile);
+                        break;
+                    case '@':
+                        match = bb_.exit.Test(tile);
+                        instance.exit = true;
+                        instance.pocket.Set(tile);
+                        break;
+                    default: // '.'
+                        instance.pocket.Set(tile);
+                        break;
+                    }
+                }
+                if (!match)
+                {
+                    continue;
+                }
+
+                // A symmetric pattern lands on the same tiles more than once
+                vector<uint32_t>& first = by_tile_[instance.boxes.First()];
+                bool known = false;
+                for (size_t i = 0; i < first.size() && !known; i++)
+                {
+                    const Instance& other = instances_[first[i]];
+                    known = other.boxes == instance.boxes && other.pocket == instance.pocket;
+                }
+                if (known)
+                {
+                    continue;
+                }
+                uint32_t index = (uint32_t)instances_.size();
+                instances_.push_back(instance);
+                Bitboard boxes = instance.boxes;
+                for (int tile = boxes.First(); tile >= 0; boxes.Clear(tile), tile = boxes.First())
+                {
+                    by_tile_[tile].push_back(index);
+                }
+            }
+        }
+    }
+}
+
+
+bool DeadlockPatterns::Load(const string& path)
+{
+    ifstream in(path.c_str());
+    if (!in)
+    {
+        return false;
+    }
+    string line;
+    while (getline(in, line))
+    {
+        if (!line.empty() && line[0] != '#')
+        {
+            Add(line);
+        }
+    }
+    return true;
+}
+
+
+bool DeadlockPatterns::Save(const string& path) const
+{
+    ofstream out(path.c_str());
+    if (!out)
+    {
+        return false;
+    }
+    vector<string> sorted(patterns_.begin(), patterns_.end());
+    sort(sorted.begin(), sorted.end());
+    out << "# Boxed In deadlock patterns: width height rows" << endl;
+    out << "# x wall or space, + frozen box, * gear, @ exit, . walled-in floor, ? any tile" << endl;
+    for (size_t i = 0; i < sorted.size(); i++)
+    {
+        out << sorted[i] << endl;
+    }
+    return !out.fail();
+}
+
+} // namespace boxedin
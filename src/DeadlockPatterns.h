@@ -0,0 +1,136 @@
+/**
+ * \file DeadlockPatterns.h
+ * \brief Box arrangements that the search has proved dead, kept so that
+ *        they are not proved again.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ */
+#ifndef DEADLOCK_PATTERNS_H__
+#define DEADLOCK_PATTERNS_H__
+
+#include <stdint.h>
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "boxedintypes.h"
+#include "Bitboard.h"
+#include "Level.h"
+#include "Node.h"
+
+namespace boxedin
+{
+
+// A pattern's boxes and enclosed floor fit in a window of this many tiles
+// on a side; the walls around them make it up to 2 tiles larger.
+#define DEADLOCK_PATTERN_SIZE_MAX 4
+
+/**
+   \class DeadlockPatterns
+   \brief Database of small box and wall patterns that can never be cleared.
+
+   A pattern is a cluster of frozen boxes and the floor they wall in with
+   the walls of the level. Each box is blocked along both axes by a wall or
+   another box of the cluster, so no box can ever move. The walled-in floor
+   holds the exit or a gear and the player is outside, so the player can
+   never reach it.
+
+   Patterns are learned from pushes that leave a box frozen: the cluster
+   of the box is worked out and, if it fits in a window of
+   DEADLOCK_PATTERN_SIZE_MAX tiles and walls in a target that is left, it is
+   added. A pattern does not depend on where it was found. It is matched
+   in all 8 rotations and reflections, at every place in the level where
+   the walls and targets match. The other boxes and tiles do not matter:
+   more walls and boxes can only freeze a box harder.
+
+   Patterns can be saved to a text file and loaded for another level, so
+   that the levels of a game start with what the earlier ones learned.
+
+   Not thread safe.
+ */
+class DeadlockPatterns
+{
+public:
+    explicit DeadlockPatterns(const Level& level);
+
+    /**
+       \returns true if pushing a box of node by action leaves a pattern
+                of the database, or a new one, which is then added. false
+                if action is not a push.
+     */
+    bool IsDeadPush(const Node& node, const ActionPoint& action);
+
+    /**
+       \brief Add the patterns of the file at path.
+       \returns false if the file cannot be read. Lines that are not
+                patterns are skipped.
+     */
+    bool Load(const std::string& path);
+
+    /** \returns false if the file at path cannot be written. */
+    bool Save(const std::string& path) const;
+
+    /** \returns Number of patterns, learned or loaded. */
+    size_t size() const { return patterns_.size(); }
+
+    /** \returns Number of places in the level that a pattern matches. */
+    size_t instances() const { return instances_.size(); }
+
+    /** \returns Number of patterns learned by IsDeadPush(). */
+    uint64_t learned() const { return learned_; }
+
+    /** \returns Number of pushes that matched a pattern already known. */
+    uint64_t hits() const { return hits_; }
+
+private:
+    // A pattern placed on the level
+    struct Instance
+    {
+        Bitboard boxes;
+        Bitboard pocket;          // walled-in tiles; the player must be outside
+        gears_bitfield_t gears;   // gears in the pocket
+        bool exit;                // the exit is in the pocket
+    };
+
+    /**
+       \brief Add a pattern and its instances.
+       \param[in] pattern "width height row/row/...", one char per tile:
+                  'x' wall or space, '+' frozen box, '*' gear, '@' exit,
+                  '.' walled-in floor and '?' any tile.
+       \returns false if pattern is not valid.
+     */
+    bool Add(const std::string& pattern);
+
+    void Instantiate(int width, int height, const std::string& cells);
+
+    /**
+       \returns true if the box pushed onto tile box freezes in a cluster
+                that walls in a target away from the player, on tile
+                player. The cluster is then added.
+       \param[in] boxes The boxes after the push.
+     */
+    bool Learn(const Node& node, int player, int box, const Bitboard& boxes);
+
+    /** \returns true if tile (x, y) is a wall, space, off the level or in solid. */
+    bool Blocks(int x, int y, const Bitboard& solid) const;
+
+    const LevelBitboards& bb_;
+    int height_;
+    Bitboard gates_;
+
+    std::unordered_set<std::string> patterns_;
+    std::vector<Instance> instances_;
+    std::vector<std::vector<uint32_t> > by_tile_; // instances with a box on each tile
+
+    uint64_t learned_;
+    uint64_t hits_;
+
+    DeadlockPatterns(const DeadlockPatterns& other); // no copy
+    DeadlockPatterns& operator=(const DeadlockPatterns& other); // no copy
+};
+
+} // namespace boxedin
+
+#endif
@@ -1,140 +1,546 @@
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+#include "astar.h" // StateBitboards
+#include "Bitboard.h"
 #include "boxedintypes.h" // cost_t
-#include "FloodFillNode.h"
 #include "Heuristic.h"
 #include "Node.h"
 
 using namespace boxedin;
 
-cost_t ShortestDistanceThroughGearsToExitHeuristic::cell_to_cell_dist(size_t cell1, size_t cell2)
+namespace {
+
+// Run work(begin, end) over [0, n), split across the hardware threads. Each
+// thread gets at least min_per_thread items, so small jobs run inline.
+void parallel_for(size_t n, size_t min_per_thread, const std::function<void(size_t, size_t)>& work)
 {
-    cost_t *cost_ptr = tile_to_tile_cost_table.Cost(cell1, cell2);
-    if (*cost_ptr != COST_UNKNOWN)
+    size_t num_threads = std::thread::hardware_concurrency();
+    num_threads = std::min(num_threads, n / min_per_thread);
+    if (num_threads <= 1)
+    {
+        work(0, n);
+        return;
+    }
+    std::vector<std::thread> threads;
+    size_t chunk = (n + num_threads - 1) / num_threads;
+    for (size_t begin = 0; begin < n; begin += chunk)
+    {
+        threads.push_back(std::thread(work, begin, std::min(begin + chunk, n)));
+    }
+    for (size_t i = 0; i < threads.size(); i++)
     {
-        return *cost_ptr;
+        threads[i].join();
     }
+}
 
-    vector<vector<char> > floor_plan = level.floor_plan_;
-    std::queue<FloodFillNode> flood_fill_queue;
-    Coord coord1(cell1 % floor_width, cell1 / floor_width);
-    Coord coord2(cell2 % floor_width, cell2 / floor_width);
-    cost_t cost = COST_INFINITY;
-    
-    // Queue of spaces to fill is initially the current player position
-    flood_fill_queue.push( FloodFillNode(coord1) );
+} // anonymous namespace
 
-    while (!flood_fill_queue.empty())
+// static
+vector<int> ShortestDistanceThroughGearsToExitHeuristic::MakeFloorIndex(const Level& level, size_t& count)
+{
+    size_t width = level.floor_plan_[0].size();
+    vector<int> index(width * level.floor_plan_.size(), -1);
+    count = 0;
+    for (size_t tile = 0; tile < index.size(); tile++)
     {
-        FloodFillNode ffnode = flood_fill_queue.front();
-        Coord& coord = ffnode.coord;
+        if (level.floor_plan_[tile / width][tile % width] == ' ')
+        {
+            index[tile] = (int)count++;
+        }
+    }
+    return index;
+}
 
-        if (coord == coord2)
+bool ShortestDistanceThroughGearsToExitHeuristic::find_gates(size_t table_bytes_max)
+{
+    gate_mask.assign(num_tiles, 0);
+    unlock_mask.assign(num_tiles, 0);
+    vector<size_t> gate_cells;
+    for (const auto& kv : level.switch_gate_pairs_)
+    {
+        size_t switch_cell = kv.second.first.y * floor_width + kv.second.first.x;
+        size_t gate_cell = kv.second.second.y * floor_width + kv.second.second.x;
+        if (floor_index[switch_cell] >= 0 && floor_index[gate_cell] >= 0)
         {
-            cost = (cost_t)ffnode.path.size();
-            break;
+            switch_cells.push_back(switch_cell);
+            gate_cells.push_back(gate_cell);
         }
-        
-        // Skip node if it's position has been filled
-        if (floor_plan[coord.y][coord.x] == '-')
+    }
+
+    // Leave out the last gates until the table fits. The shift would
+    // overflow long before a table of 2^40 rows is the right choice.
+    bool fits = num_gears < 40 &&
+        num_floor_tiles * sizeof(hscore_entry_t) * ((size_t)1 << num_gears) <= table_bytes_max;
+    while (!switch_cells.empty() &&
+           (!fits ||
+            num_floor_tiles * sizeof(hscore_entry_t) * ((size_t)1 << (switch_cells.size() + num_gears)) >
+            table_bytes_max))
+    {
+        switch_cells.pop_back();
+        gate_cells.pop_back();
+    }
+    num_gates = switch_cells.size();
+
+    for (size_t c = 0; c < num_gates; c++)
+    {
+        gate_mask[gate_cells[c]] |= 1 << c;
+        size_t x = switch_cells[c] % floor_width;
+        if (switch_cells[c] >= floor_width)
+            unlock_mask[switch_cells[c] - floor_width] |= 1 << c; // up
+        if (switch_cells[c] + floor_width < num_tiles)
+            unlock_mask[switch_cells[c] + floor_width] |= 1 << c; // down
+        if (x > 0)
+            unlock_mask[switch_cells[c] - 1] |= 1 << c; // left
+        if (x < floor_width - 1)
+            unlock_mask[switch_cells[c] + 1] |= 1 << c; // right
+    }
+    return fits;
+}
+
+void ShortestDistanceThroughGearsToExitHeuristic::distances_from(size_t cell, unsigned unlocked, cost_t* row) const
+{
+    size_t num_masks = (size_t)1 << num_gates;
+    for (size_t state = 0; state < num_masks * num_floor_tiles; state++)
+    {
+        row[state] = COST_INFINITY;
+    }
+    // Breadth first over the floor tiles and sets of unlocked gates; every
+    // pair is queued once. A queued pair is unlocked * num_tiles + tile.
+    vector<size_t> queue;
+    queue.reserve(num_masks * num_floor_tiles);
+    unlocked |= unlock_mask[cell];
+    queue.push_back(unlocked * num_tiles + cell);
+    row[unlocked * num_floor_tiles + floor_index[cell]] = 0;
+    for (size_t head = 0; head < queue.size(); head++)
+    {
+        size_t tile = queue[head] % num_tiles;
+        unlocked = (unsigned)(queue[head] / num_tiles);
+        size_t x = tile % floor_width;
+        cost_t distance = row[unlocked * num_floor_tiles + floor_index[tile]] + 1;
+        size_t neighbors[4];
+        int n = 0;
+        if (tile >= floor_width)
+            neighbors[n++] = tile - floor_width; // up
+        if (tile + floor_width < num_tiles)
+            neighbors[n++] = tile + floor_width; // down
+        if (x > 0)
+            neighbors[n++] = tile - 1; // left
+        if (x < floor_width - 1)
+            neighbors[n++] = tile + 1; // right
+        for (int i = 0; i < n; i++)
         {
-            flood_fill_queue.pop();
-            continue;
+            int floor = floor_index[neighbors[i]];
+            if (floor < 0 || (gate_mask[neighbors[i]] & ~unlocked))
+            {
+                continue;
+            }
+            unsigned next = unlocked | unlock_mask[neighbors[i]];
+            if (row[next * num_floor_tiles + floor] == COST_INFINITY)
+            {
+                row[next * num_floor_tiles + floor] = distance;
+                queue.push_back(next * num_tiles + neighbors[i]);
+            }
         }
+    }
+}
+
 
-        // Mark current point as filled
-        floor_plan[coord.y][coord.x] = '-';
+void ShortestDistanceThroughGearsToExitHeuristic::find_legs(size_t cell, unsigned unlocked, cost_t* row,
+                                                            vector<Leg>& legs, size_t* first) const
+{
+    unsigned num_masks = 1u << num_gates;
+    distances_from(cell, unlocked, row);
+    for (size_t t = 0; t < target_cells.size(); t++)
+    {
+        first[t] = legs.size();
+        size_t floor = floor_index[target_cells[t]];
+        for (unsigned arrival = 0; arrival < num_masks; arrival++)
+        {
+            cost_t cost = row[arrival * num_floor_tiles + floor];
+            if (cost == COST_INFINITY)
+            {
+                continue;
+            }
+            // Drop the leg if one with more gates unlocked is as short
+            bool dominated = false;
+            for (unsigned more = (arrival + 1) | arrival; more < num_masks; more = (more + 1) | arrival)
+            {
+                if (row[more * num_floor_tiles + floor] <= cost)
+                {
+                    dominated = true;
+                    break;
+                }
+            }
+            if (!dominated)
+            {
+                Leg leg = { cost, arrival };
+                legs.push_back(leg);
+            }
+        }
+    }
+    first[target_cells.size()] = legs.size();
+}
 
-        //// Add neighbor nodes in the 4 directions ////
 
-        // UP
-        if ( (coord.y > 0) && (floor_plan[coord.y-1][coord.x] == ' ') )
+cost_t ShortestDistanceThroughGearsToExitHeuristic::cell_to_cell_dist(size_t cell1, size_t cell2)
+{
+    // Distances are symmetric, so a row of either target will do
+    for (size_t t = 0; t < target_cells.size(); t++)
+    {
+        if (target_cells[t] == cell2)
         {
-            FloodFillNode up( ffnode ); // copy of node
-            up.path.push_back(ENCODED_PATH_DIRECTION_UP);
-            up.coord.y--;
-            flood_fill_queue.push( up );
+            return target_distance[t * num_floor_tiles + floor_index[cell1]];
         }
-        // DOWN
-        if ( (coord.y < floor_height-1) && (floor_plan[coord.y+1][coord.x] == ' ') )
+        if (target_cells[t] == cell1)
         {
-            FloodFillNode down( ffnode ); // copy of node
-            down.path.push_back(ENCODED_PATH_DIRECTION_DOWN);
-            down.coord.y++;
-            flood_fill_queue.push( down );
+            return target_distance[t * num_floor_tiles + floor_index[cell2]];
         }
-        // LEFT
-        if ( (coord.x > 0) && (floor_plan[coord.y][coord.x-1] == ' ') )
+    }
+    // Neither is a gear or the exit; the search never asks for these
+    unsigned all_gates = (1u << num_gates) - 1;
+    vector<cost_t> row(num_floor_tiles << num_gates);
+    distances_from(cell1, all_gates, &row[0]);
+    return row[all_gates * num_floor_tiles + floor_index[cell2]];
+}
+
+
+void ShortestDistanceThroughGearsToExitHeuristic::compute_target_distances()
+{
+    for (size_t i = 0; i < num_gears; i++)
+    {
+        const Coord& gear_coord = level.gear_coords_[i];
+        target_cells.push_back((gear_coord.y * floor_width) + gear_coord.x);
+    }
+    target_cells.push_back((level.exit_coord_.y * floor_width) + level.exit_coord_.x);
+
+    // With every gate unlocked, the walk stays in the last layer
+    unsigned all_gates = (1u << num_gates) - 1;
+    vector<cost_t> row(num_floor_tiles << num_gates);
+    target_distance.resize(target_cells.size() * num_floor_tiles);
+    for (size_t t = 0; t < target_cells.size(); t++)
+    {
+        distances_from(target_cells[t], all_gates, &row[0]);
+        copy(row.begin() + all_gates * num_floor_tiles, row.end(),
+             target_distance.begin() + t * num_floor_tiles);
+    }
+}
+
+
+void ShortestDistanceThroughGearsToExitHeuristic::compute_hscore_table()
+{
+    size_t num_subsets = (size_t)1 << num_gears;
+    size_t num_masks = (size_t)1 << num_gates;
+    size_t num_targets = target_cells.size();
+    size_t exit = num_gears;
+
+    // The legs from each gear with each set of unlocked gates. Those from
+    // gear i with unlocked to target t start at
+    // gear_first[(i * num_masks + unlocked) * (num_targets + 1) + t].
+    vector<Leg> gear_legs;
+    vector<size_t> gear_first(num_gears * num_masks * (num_targets + 1));
+    vector<cost_t> row(num_floor_tiles << num_gates);
+    for (size_t i = 0; i < num_gears; i++)
+    {
+        for (size_t unlocked = 0; unlocked < num_masks; unlocked++)
         {
-            FloodFillNode left( ffnode ); // copy of node
-            left.path.push_back(ENCODED_PATH_DIRECTION_LEFT);
-            left.coord.x--;
-            flood_fill_queue.push( left );
+            find_legs(target_cells[i], (unsigned)unlocked, &row[0], gear_legs,
+                      &gear_first[(i * num_masks + unlocked) * (num_targets + 1)]);
         }
-        // RIGHT
-        if ( (coord.x < floor_width-1) && (floor_plan[coord.y][coord.x+1] == ' ') )
+    }
+
+    // tour[((remaining << num_gates) | unlocked) * num_gears + i] is the cost
+    // from gear i, with the gates of unlocked, through the gears of remaining
+    // (a subset without gear i) to the exit
+    vector<cost_t> tour(num_subsets * num_masks * num_gears, COST_INFINITY);
+    for (size_t i = 0; i < num_gears; i++)
+    {
+        for (size_t unlocked = 0; unlocked < num_masks; unlocked++)
         {
-            FloodFillNode right( ffnode ); // copy of node
-            right.path.push_back(ENCODED_PATH_DIRECTION_RIGHT);
-            right.coord.x++;
-            flood_fill_queue.push( right );
+            const size_t* first = &gear_first[(i * num_masks + unlocked) * (num_targets + 1)];
+            for (size_t l = first[exit]; l < first[exit + 1]; l++)
+            {
+                tour[unlocked * num_gears + i] = min(tour[unlocked * num_gears + i], gear_legs[l].cost);
+            }
         }
     }
+    for (size_t size = 1; size < num_gears; size++)
+    {
+        // Every subset of this size only needs subsets one gear smaller
+        parallel_for(num_subsets * num_masks, 1 << 12, [&](size_t begin, size_t end)
+        {
+            for (size_t state = begin; state < end; state++)
+            {
+                size_t remaining = state >> num_gates;
+                size_t unlocked = state & (num_masks - 1);
+                if ((size_t)__builtin_popcountll(remaining) != size)
+                {
+                    continue;
+                }
+                for (size_t i = 0; i < num_gears; i++)
+                {
+                    if (remaining & ((size_t)1 << i))
+                    {
+                        continue;
+                    }
+                    const size_t* first = &gear_first[(i * num_masks + unlocked) * (num_targets + 1)];
+                    cost_t best_cost = COST_INFINITY;
+                    for (size_t gears = remaining; gears; gears &= gears - 1)
+                    {
+                        size_t j = __builtin_ctzll(gears);
+                        size_t rest_row = (remaining & ~((size_t)1 << j)) << num_gates;
+                        for (size_t l = first[j]; l < first[j + 1]; l++)
+                        {
+                            cost_t rest = tour[(rest_row | gear_legs[l].unlocked) * num_gears + j];
+                            if (rest != COST_INFINITY && gear_legs[l].cost + rest < best_cost)
+                            {
+                                best_cost = gear_legs[l].cost + rest;
+                            }
+                        }
+                    }
+                    tour[state * num_gears + i] = best_cost;
+                }
+            }
+        });
+    }
 
-    *cost_ptr = cost;
-    return cost;
+    // Every floor tile goes to the best first gear of each subset
+    vector<size_t> floor_cells(num_floor_tiles);
+    for (size_t tile = 0; tile < num_tiles; tile++)
+    {
+        if (floor_index[tile] >= 0)
+        {
+            floor_cells[floor_index[tile]] = tile;
+        }
+    }
+    parallel_for(num_floor_tiles, 16, [&](size_t begin, size_t end)
+    {
+        vector<cost_t> row(num_floor_tiles << num_gates);
+        vector<Leg> legs;
+        vector<size_t> first(num_targets + 1);
+        for (size_t floor = begin; floor < end; floor++)
+        {
+            for (size_t unlocked = 0; unlocked < num_masks; unlocked++)
+            {
+                legs.clear();
+                find_legs(floor_cells[floor], (unsigned)unlocked, &row[0], legs, &first[0]);
+                hscore_entry_t* entries = &hscore_table[((floor << num_gates) | unlocked) << num_gears];
+                cost_t to_exit = COST_INFINITY;
+                for (size_t l = first[exit]; l < first[exit + 1]; l++)
+                {
+                    to_exit = min(to_exit, legs[l].cost);
+                }
+                entries[0] = (to_exit == COST_INFINITY) ? HSCORE_ENTRY_INFINITY
+                                                        : (hscore_entry_t)to_exit;
+                for (size_t gears_bitfield = 1; gears_bitfield < num_subsets; gears_bitfield++)
+                {
+                    cost_t best_cost = COST_INFINITY;
+                    for (size_t gears = gears_bitfield; gears; gears &= gears - 1)
+                    {
+                        size_t i = __builtin_ctzll(gears);
+                        size_t rest_row = (gears_bitfield & ~((size_t)1 << i)) << num_gates;
+                        for (size_t l = first[i]; l < first[i + 1]; l++)
+                        {
+                            cost_t rest = tour[(rest_row | legs[l].unlocked) * num_gears + i];
+                            if (rest != COST_INFINITY && legs[l].cost + rest < best_cost)
+                            {
+                                best_cost = legs[l].cost + rest;
+                            }
+                        }
+                    }
+                    entries[gears_bitfield] = (best_cost >= HSCORE_ENTRY_INFINITY) ? HSCORE_ENTRY_INFINITY
+                                                                                   : (hscore_entry_t)best_cost;
+                }
+            }
+        }
+    });
 }
 
 
-cost_t ShortestDistanceThroughGearsToExitHeuristic::get_hscore(size_t cell, uint16_t gears_bitfield)
+void ShortestDistanceThroughGearsToExitHeuristic::compute_target_to_target()
 {
-#if 0
-    fprintf(stderr, "cell=%lu num_gears=%lu gears=0x%04x\n", cell, num_gears, gears_bitfield);
-#endif
-    cost_t *cost_ptr = &(hscore_table[cell * (1 << num_gears) + gears_bitfield]);
-    if (*cost_ptr != COST_UNKNOWN)
+    size_t num_targets = target_cells.size();
+    target_to_target.resize(num_targets * num_targets);
+    for (size_t t1 = 0; t1 < num_targets; t1++)
     {
-#if 0
-        fprintf(stderr, "    cost already known %p (%d)\n", cost_ptr, *cost_ptr);
-#endif
-        return *cost_ptr;
+        for (size_t t2 = 0; t2 < num_targets; t2++)
+        {
+            target_to_target[t1 * num_targets + t2] =
+                target_distance[t1 * num_floor_tiles + floor_index[target_cells[t2]]];
+        }
     }
+    mst_cache = new atomic<uint64_t>[MST_CACHE_ENTRIES]();
+}
 
 
-    if (gears_bitfield == 0)
+cost_t ShortestDistanceThroughGearsToExitHeuristic::mst_hscore(size_t cell, gears_bitfield_t gears_bitfield) const
+{
+    // The first step of the walk: to the nearest target that is left
+    size_t floor = floor_index[cell];
+    cost_t nearest = target_distance[num_gears * num_floor_tiles + floor];
+    for (gears_bitfield_t gears = gears_bitfield; gears; gears &= gears - 1)
     {
-        size_t exit_cell = ((level.exit_coord_.y * floor_width) + level.exit_coord_.x);
-        *cost_ptr = cell_to_cell_dist(cell, exit_cell);
-#if 0
-        fprintf(stderr, "    robot-to-exit distance %lu..%lu is %d\n", cell, exit_cell, *cost_ptr);
-#endif
-        return *cost_ptr;
+        size_t i = __builtin_ctzll(gears);
+        nearest = min(nearest, target_distance[i * num_floor_tiles + floor]);
     }
+    if (nearest == COST_INFINITY)
+    {
+        return COST_INFINITY;
+    }
+    cost_t tree = mst_weight(gears_bitfield);
+    return (tree == COST_INFINITY) ? COST_INFINITY : nearest + tree;
+}
 
-    cost_t best_cost = COST_INFINITY;
-    for (size_t i = 0; i < num_gears; i++)
+
+cost_t ShortestDistanceThroughGearsToExitHeuristic::mst_weight(gears_bitfield_t gears_bitfield) const
+{
+    // splitmix64 finalizer. It is a bijection and the slot and the tag
+    // cover all of its bits, so a matching tag is the same gear set.
+    uint64_t hash = (uint64_t)gears_bitfield;
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    hash = hash ^ (hash >> 31);
+    size_t slot = hash & (MST_CACHE_ENTRIES - 1);
+    uint64_t tag = hash >> 16;
+
+    uint64_t entry = mst_cache[slot].load(memory_order_relaxed);
+    if (entry != 0 && (entry >> 16) == tag)
+    {
+        uint64_t weight = (entry & 0xFFFF) - 1;
+        return (weight == 0xFFFE) ? COST_INFINITY : (cost_t)weight;
+    }
+
+    // Prim's algorithm over the gears of the set and the exit
+    size_t num_targets = target_cells.size();
+    size_t targets[GEARS_MAX + 1];
+    cost_t reach[GEARS_MAX + 1]; // cost to join the tree
+    size_t n = 0;
+    for (gears_bitfield_t gears = gears_bitfield; gears; gears &= gears - 1)
     {
-        uint16_t checkbit = 1 << i;
-        if (checkbit & gears_bitfield)
+        targets[n++] = __builtin_ctzll(gears);
+    }
+    targets[n++] = num_gears; // the exit, which starts the tree
+    cost_t weight = 0;
+    size_t last = num_gears;
+    for (size_t i = 0; i + 1 < n; i++)
+    {
+        reach[i] = COST_INFINITY;
+    }
+    for (size_t left = n - 1; left > 0 && weight != COST_INFINITY; left--)
+    {
+        size_t best = 0;
+        for (size_t i = 0; i < left; i++)
         {
-            const Coord& gear_coord = level.gear_coords_[i];
-            size_t gear_cell = ((gear_coord.y * floor_width) + gear_coord.x);
-            cost_t cost = cell_to_cell_dist(cell, gear_cell) + get_hscore(gear_cell, gears_bitfield & ~checkbit);
-            best_cost = (cost < best_cost) ? cost : best_cost;
+            reach[i] = min(reach[i], target_to_target[last * num_targets + targets[i]]);
+            if (reach[i] < reach[best])
+            {
+                best = i;
+            }
         }
+        weight = (reach[best] == COST_INFINITY) ? COST_INFINITY : weight + reach[best];
+        last = targets[best];
+        targets[best] = targets[left - 1];
+        reach[best] = reach[left - 1];
     }
 
-    *cost_ptr = best_cost;
-    return *cost_ptr;
+    uint64_t stored = (weight == COST_INFINITY) ? 0xFFFE : (uint64_t)weight;
+    mst_cache[slot].store((tag << 16) | (stored + 1), memory_order_relaxed);
+    return weight;
 }
 
 
-// virtual
-cost_t ShortestDistanceThroughGearsToExitHeuristic::get_hscore(const Node& node)
+cost_t FirstPushHeuristic::expansion_hscore(const Node& node) const
 {
-    size_t robot_cell = ((node.player_coord_.y * floor_width) + node.player_coord_.x);
-    uint16_t gears_bitfield = node.gear_descriptor_.bitfield;
-    cost_t hscore = get_hscore(robot_cell, gears_bitfield);
-#if 0
-    fprintf(stderr, "getting hscore for robot at (%u,%u)...%d\n", node.player_coord_.x, node.player_coord_.y, hscore);
-#endif
-    return hscore;
+    const LevelBitboards& bb = level.bitboards_;
+    StateBitboards state(bb, node);
+    int start = bb.TileIndex(node.player_coord_);
+
+    // Tiles next to a box that can be pushed up, down, left, right. A gear
+    // in the region may be collected first, so a box may be pushed onto it.
+    Bitboard holdable = state.walkable.AndNot(bb.exit);
+    Bitboard pushes[4];
+    pushes[0] = bb.Down(state.boxes & bb.Down(holdable));
+    pushes[1] = bb.Up(state.boxes & bb.Up(holdable));
+    pushes[2] = bb.Right(state.boxes & bb.Right(holdable));
+    pushes[3] = bb.Left(state.boxes & bb.Left(holdable));
+    const int offsets[4] = { -bb.width, bb.width, -1, 1 };
+
+    Bitboard goals = bb.exit;
+    for (size_t i = 0; i < bb.gears.size(); i++)
+    {
+        if (node.gear_descriptor_.bitfield & ((gears_bitfield_t)1 << i))
+        {
+            goals |= bb.gears[i];
+        }
+    }
+
+    // Breadth first over the region the player can walk in without a push,
+    // noting the box of each push and how far away it is. Regions are small
+    // and long, so this visits tiles one at a time rather than stepping a
+    // Bitboard frontier.
+    struct Push
+    {
+        cost_t distance;
+        int box;
+    };
+    Push candidates[4 * BITBOARD_TILES];
+    int num_candidates = 0;
+    int queue[BITBOARD_TILES];
+    cost_t distance[BITBOARD_TILES];
+    int tail = 0;
+    Bitboard region = Bitboard::Tile(start);
+    queue[tail] = start;
+    distance[tail++] = 0;
+    for (int head = 0; head < tail; head++)
+    {
+        int tile = queue[head];
+        bool steps[4] = { tile >= bb.width, tile + bb.width < bb.tiles,
+                          bb.not_left_column.Test(tile), bb.not_right_column.Test(tile) };
+        for (int d = 0; d < 4; d++)
+        {
+            if (!steps[d])
+            {
+                continue;
+            }
+            int next = tile + offsets[d];
+            if (pushes[d].Test(tile))
+            {
+                Push push = { distance[head], next };
+                candidates[num_candidates++] = push;
+            }
+            else if (state.walkable.Test(next) && !region.Test(next))
+            {
+                region.Set(next);
+                queue[tail] = next;
+                distance[tail++] = distance[head] + 1;
+            }
+        }
+    }
+    if (!goals.AndNot(region).Any())
+    {
+        return 0;
+    }
+
+    // After the first push, the gears outside of the region are left
+    gears_bitfield_t outside = 0;
+    for (size_t i = 0; i < bb.gears.size(); i++)
+    {
+        if (!(bb.gears[i] & region).Any())
+        {
+            outside |= (gears_bitfield_t)1 << i;
+        }
+    }
+    outside &= node.gear_descriptor_.bitfield;
+    unsigned unlocked = walk.unlocked_gates(node);
+    cost_t best_cost = COST_INFINITY;
+    for (int i = 0; i < num_candidates; i++)
+    {
+        cost_t rest = walk.get_hscore(candidates[i].box, unlocked, outside);
+        if (rest != COST_INFINITY && candidates[i].distance + 1 + rest < best_cost)
+        {
+            best_cost = candidates[i].distance + 1 + rest;
+        }
+    }
+    return best_cost;
 }
@@ -1,6 +1,9 @@
 #ifndef BOXED_IN_HEURISTIC
 #define BOXED_IN_HEURISTIC
 
+#include <algorithm>
+#include <atomic>
+
 #include "boxedintypes.h"
 #include "Level.h"
 #include "Node.h"
@@ -14,103 +17,184 @@ class Node; // forward
     
 struct Heuristic
 {
+    virtual ~Heuristic() {}
+
     virtual cost_t get_hscore(const Node& node) = 0;
-};
 
+    // A bound at least as high as get_hscore(), for a Node that is about to
+    // be expanded. A bound that is too slow to compute for every successor
+    // goes here: A* puts the Node back in the open set if it is higher.
+    virtual cost_t get_expansion_hscore(const Node& node) { return get_hscore(node); }
 
-//             x
-//
-//       0 1 2 3 4 5 6
-//     0 a b c d e f g
-//     1 b h i j k l m
-//     2 c i n o p q r
-//  y  3 d j o s t u v
-//     4 e k p t w x y
-//     5 f l q u x z A
-//     6 g m r v y A B
-
-//             x
-//
-//       0 1 2 3 4 5 6
-//     0 a b c d e f g
-//     1 - h i j k l m
-//     2 - - n o p q r
-//  y  3 - - - s t u v
-//     4 - - - - w x y
-//     5 - - - - - z A
-//     6 - - - - - - B
-//
-//     rect_offset = x * table_width + y;
-//     table_offset = rect_offset - (∑ 1 to y);
-//     table_offset = rect_offset - ((y * (y + 1)) / 2);
-
-class SymmetricCostTable
-{
-public:
-    cost_t* table;
-    size_t table_width;
-    
-    SymmetricCostTable(size_t table_width)
-        : table_width(table_width)
+    // Set the hscore of count new Nodes; one call for all of the successors
+    // of an expansion.
+    virtual void set_hscores(Node* const* nodes, size_t count)
     {
-        size_t n = (table_width * (table_width + 1)) / 2;
-        table = new cost_t[n];
-        
-        for (size_t row = 0; row < table_width; row++)
+        for (size_t i = 0; i < count; i++)
         {
-            for (size_t col = 0; col < table_width; col++)
-            {
-                if (row == col)
-                {
-                    Cost(row, col, 0);
-                }
-                else
-                {
-                    Cost(row, col, COST_UNKNOWN);
-                }
-            }
+            nodes[i]->set_hscore(get_hscore(*nodes[i]));
         }
     }
 
-    ~SymmetricCostTable()
+    // Fill every lazily computed table so that get_hscore() only reads. After
+    // precompute() returns, get_hscore() may be called from several threads
+    // at once.
+    virtual void precompute() {}
+};
+
+
+/**
+   \struct HeuristicTerm
+   \brief Base of a heuristic whose bounds are plain member functions, so
+          that the combinators below and set_hscores() call them without
+          virtual dispatch.
+
+   Derived provides
+
+       cost_t hscore(const Node& node) const;
+
+   and, if it has a bound that is too slow for every successor,
+
+       cost_t expansion_hscore(const Node& node) const;
+
+   The search still holds a Heuristic&; it makes one virtual call per
+   expansion instead of one per Node.
+ */
+template <class Derived>
+struct HeuristicTerm : public Heuristic
+{
+    cost_t expansion_hscore(const Node& node) const { return derived().hscore(node); }
+
+    virtual cost_t get_hscore(const Node& node) { return derived().hscore(node); }
+
+    virtual cost_t get_expansion_hscore(const Node& node)
     {
-        delete table;
+        // The hscore of a Node starts at the cheap bound, so a higher one
+        // was raised already
+        cost_t hscore = derived().hscore(node);
+        if (hscore == COST_INFINITY || (cost_t)node.hscore_ > hscore)
+        {
+            return max(hscore, (cost_t)node.hscore_);
+        }
+        return derived().expansion_hscore(node);
     }
 
-    size_t get_memory_offset(size_t x, size_t y)
+    virtual void set_hscores(Node* const* nodes, size_t count)
     {
-        size_t table_offset;
-        size_t memory_offset;
-        if (y > x)
+        for (size_t i = 0; i < count; i++)
         {
-            size_t temp = x;
-            x = y;
-            y = temp;
+            nodes[i]->set_hscore(derived().hscore(*nodes[i]));
         }
-        table_offset = (y * table_width) + x;
-        memory_offset = table_offset - ((y * (y + 1)) / 2);
-        return memory_offset;
     }
-    
-    void Cost(size_t x, size_t y, cost_t cost)
+
+private:
+    const Derived& derived() const { return static_cast<const Derived&>(*this); }
+};
+
+
+/**
+   \struct MaxHeuristic
+   \brief The higher of two admissible bounds, which is admissible.
+ */
+template <class A, class B>
+struct MaxHeuristic : public HeuristicTerm<MaxHeuristic<A, B> >
+{
+    const A& a;
+    const B& b;
+
+    MaxHeuristic(const A& a, const B& b) : a(a), b(b) {}
+
+    cost_t hscore(const Node& node) const
     {
-        size_t memory_offset = get_memory_offset(x, y);
-        table[memory_offset] = cost;
+        return max(a.hscore(node), b.hscore(node));
     }
 
-    cost_t* Cost(size_t x, size_t y)
+    cost_t expansion_hscore(const Node& node) const
     {
-        size_t memory_offset = get_memory_offset(x, y);
-        cost_t* cost = &table[memory_offset];
-        return cost;
+        return max(a.expansion_hscore(node), b.expansion_hscore(node));
+    }
+};
+
+
+/**
+   \struct AddHeuristic
+   \brief The sum of two bounds. It is only admissible if no move is
+          counted by both, e.g. walking steps and pushes that are not steps.
+ */
+template <class A, class B>
+struct AddHeuristic : public HeuristicTerm<AddHeuristic<A, B> >
+{
+    const A& a;
+    const B& b;
+
+    AddHeuristic(const A& a, const B& b) : a(a), b(b) {}
+
+    static cost_t add(cost_t x, cost_t y)
+    {
+        return (x == COST_INFINITY || y == COST_INFINITY) ? COST_INFINITY : x + y;
+    }
+
+    cost_t hscore(const Node& node) const
+    {
+        return add(a.hscore(node), b.hscore(node));
+    }
+
+    cost_t expansion_hscore(const Node& node) const
+    {
+        return add(a.expansion_hscore(node), b.expansion_hscore(node));
     }
-private:
-    SymmetricCostTable(SymmetricCostTable& other); // no copy
-    SymmetricCostTable& operator=(SymmetricCostTable& other); // no copy
 };
 
 
-struct ShortestDistanceThroughGearsToExitHeuristic : public Heuristic
+// Type of the hscore_table entries. Every hscore fits: it is a sum of at
+// most GEARS_MAX + 1 distances, each shorter than the number of tiles.
+typedef uint16_t hscore_entry_t;
+
+// hscore_table entry of a state from which the exit cannot be reached
+#define HSCORE_ENTRY_INFINITY UINT16_MAX
+
+// Largest hscore_table, in bytes. Gates are left out of the table (treated
+// as open) until it fits. If it does not fit without gates, the heuristic
+// falls back to a spanning tree bound.
+#ifndef HSCORE_TABLE_BYTES_MAX
+#define HSCORE_TABLE_BYTES_MAX ((size_t)64 << 20)
+#endif
+
+// Entries of the spanning tree cache, 8 bytes each. A power of 2.
+#ifndef MST_CACHE_ENTRIES
+#define MST_CACHE_ENTRIES ((size_t)1 << 16)
+#endif
+
+/**
+   \struct ShortestDistanceThroughGearsToExitHeuristic
+   \brief Length of the shortest walk from the player through every gear that
+          is left to the exit, ignoring boxes but not gates.
+
+   A closed gate only opens when a box is pushed onto its switch, and the
+   player is next to the switch right after that push. So the walk may not
+   cross a gate until it has been next to the gate's switch, unless a box is
+   already on the switch. The walk keeps the set of gates it has unlocked
+   this way; the tables have one layer per set.
+
+   The whole table is computed by the constructor, so get_hscore() only
+   reads and may be called from several threads at once. First the shortest
+   tour from each gear, with each set of unlocked gates, through each subset
+   of the other gears to the exit is found by dynamic programming over the
+   subsets (Held-Karp), one subset size at a time. Then every floor tile
+   takes the best first gear of each subset. Both passes are spread over the
+   hardware threads.
+
+   The table has 2^num_gears entries per floor tile. When it would not fit
+   in table_bytes_max even without gates, there is no table and no gates;
+   the bound is the distance from the player to the nearest gear left (or
+   the exit) plus the weight of a minimum spanning tree over the gears left
+   and the exit. Taking its first step away, the walk is a path through
+   those targets, which weighs at least as much as their spanning tree. The
+   tree weight of each gear set is cached; the cache is shared by every
+   thread and needs no lock.
+ */
+struct ShortestDistanceThroughGearsToExitHeuristic
+    : public HeuristicTerm<ShortestDistanceThroughGearsToExitHeuristic>
 {
     const Level& level;
 
@@ -121,55 +205,217 @@ struct ShortestDistanceThroughGearsToExitHeuristic : public Heuristic
     size_t num_tiles;
 
     size_t num_gears;
+
+    // Dense index of each floor tile (the tiles the player can stand on), or
+    // -1 for walls and space. The tables below only have rows for floor
+    // tiles.
+    //
+    // size_t tile = y * row_width + x;
+    // int floor = floor_index[tile];
+    vector<int> floor_index;
+
+    size_t num_floor_tiles;
+
+    // Gates the tables take into account, in the order of
+    // level.switch_gate_pairs_. Gate c is bit c of an unlocked set.
+    size_t num_gates;
+
+    // Tile of the switch of each gate
+    vector<size_t> switch_cells;
+
+    // Per tile, the gate on it (as a set of one gate) or 0
+    vector<uint8_t> gate_mask;
+
+    // Per tile, the gates whose switch is next to it
+    vector<uint8_t> unlock_mask;
     
-    // Cost from tile to tile, taking walls into account but ignoring gates and boxes.
-    // \note This table is not indexed by x,y coords of 2 tiles, but rather the
-    // tile index of 2 tiles where tile index is y * row_width + x.
+    // Tile of each gear, then the tile of the exit
+    vector<size_t> target_cells;
+
+    // Cost from every floor tile to each target, taking walls into account
+    // but ignoring gates and boxes. One breadth first search per target
+    // fills its row.
     //
-    // size_t tile1 = y1 * row_width + x1;
-    // size_t tile2 = y2 * row_width + x2;
-    // cost_t cost = tile_to_tile_cost_table.Cost(tile1, tile2);
-    SymmetricCostTable tile_to_tile_cost_table;
+    // cost_t cost = target_distance[target * num_floor_tiles + floor_index[tile]];
+    vector<cost_t> target_distance;
 
     // Cost from tile through gears to exit.
     //
-    // Index by tile offset and gears bitfield.
+    // Index by floor index, gates unlocked and gears bitfield.
     //
-    // size_t player_offset = player_y * row_width + player_x
-    // cost_t hscore = hscore_table[player_offset * num_gears + gears_bitfield];
+    // size_t player_floor = floor_index[player_y * row_width + player_x]
+    // size_t row = (player_floor << num_gates) | unlocked;
+    // hscore_entry_t hscore = hscore_table[(row << num_gears) | gears_bitfield];
     //
-    // \note If there are 140 tiles and 12 gears, the table size is
-    //       140 * (2^12) = 573440!
-    cost_t *hscore_table;
-    
-    ShortestDistanceThroughGearsToExitHeuristic(const Level& level)
+    // \note If there are 120 floor tiles, 12 gears and 2 gates, the table size
+    //       is 120 * (2^2) * (2^12) = 1966080!
+    //
+    // NULL if the table does not fit; see mst_hscore().
+    hscore_entry_t *hscore_table;
+
+    // Without a table: cost from target to target, ignoring gates.
+    //
+    // cost_t cost = target_to_target[t1 * (num_gears + 1) + t2];
+    vector<cost_t> target_to_target;
+
+    // Without a table: weight of the spanning tree of each gear set, plus
+    // the exit. An entry is (tag << 16) | (weight + 1), where the slot and
+    // the tag are the low and high bits of a hash of the gear set. 0 is an
+    // empty slot and a weight of 0xFFFE means the targets are not connected.
+    std::atomic<uint64_t> *mst_cache;
+
+    ShortestDistanceThroughGearsToExitHeuristic(const Level& level,
+                                                size_t table_bytes_max = HSCORE_TABLE_BYTES_MAX)
         : level(level)
         , floor_width(level.floor_plan_[0].size())
         , floor_height(level.floor_plan_.size())
         , num_tiles(floor_width * floor_height)
         , num_gears(level.gear_coords_.size())
-        , tile_to_tile_cost_table(num_tiles)
+        , floor_index(MakeFloorIndex(level, num_floor_tiles))
+        , hscore_table(NULL)
+        , mst_cache(NULL)
     {
-        size_t sz = num_tiles * (1 << num_gears);
-#if 1
-        fprintf(stderr, "floor_width %lu floor_height %lu num_tiles %lu num_gears %lu\n", floor_width, floor_height, num_tiles, num_gears);
-        fprintf(stderr, "allocating hscore_table of size %lu ===========================================\n", sz);
-#endif
-        hscore_table = new cost_t[sz];
-        for (size_t i = 0; i < sz; i++)
+        bool fits = find_gates(table_bytes_max);
+        compute_target_distances();
+        if (fits)
         {
-            hscore_table[i] = COST_UNKNOWN;
+            hscore_table = new hscore_entry_t[num_floor_tiles * ((size_t)1 << (num_gates + num_gears))];
+            compute_hscore_table();
+        }
+        else
+        {
+            compute_target_to_target();
         }
     }
     
     ~ShortestDistanceThroughGearsToExitHeuristic()
     {
-        delete hscore_table;
+        delete[] hscore_table;
+        delete[] mst_cache;
     }
 
+    // Dense index of the floor tiles of level; count is set to their number
+    static vector<int> MakeFloorIndex(const Level& level, size_t& count);
+
+    // Cost from tile to tile, ignoring gates. A lookup if either tile is a
+    // gear or the exit.
     cost_t cell_to_cell_dist(size_t cell1, size_t cell2);
-    cost_t get_hscore(size_t cell, uint16_t gears_bitfield);
-    virtual cost_t get_hscore(const Node& node);
+
+    // Fill row (num_floor_tiles entries per set of unlocked gates) with the
+    // cost from cell to every floor tile, COST_INFINITY if there is no path.
+    // The walk starts with the gates of unlocked.
+    //
+    // cost_t cost = row[gates_unlocked_on_arrival * num_floor_tiles + floor];
+    void distances_from(size_t cell, unsigned unlocked, cost_t* row) const;
+
+    cost_t get_hscore(size_t cell, unsigned unlocked, gears_bitfield_t gears_bitfield) const
+    {
+        if (hscore_table == NULL)
+        {
+            return mst_hscore(cell, gears_bitfield);
+        }
+        size_t row = ((size_t)floor_index[cell] << num_gates) | unlocked;
+        hscore_entry_t hscore = hscore_table[(row << num_gears) | gears_bitfield];
+        return (hscore == HSCORE_ENTRY_INFINITY) ? COST_INFINITY : (cost_t)hscore;
+    }
+
+    // With every gate closed
+    cost_t get_hscore(size_t cell, gears_bitfield_t gears_bitfield) const
+    {
+        return get_hscore(cell, 0, gears_bitfield);
+    }
+
+    // Gates whose switch holds a box in node; they are open now
+    unsigned unlocked_gates(const Node& node) const
+    {
+        unsigned unlocked = 0;
+        for (size_t c = 0; c < num_gates; c++)
+        {
+            size_t cell = switch_cells[c];
+            if ((node.box_descriptor_.bitfields[cell >> 6] >> (cell & 63)) & 1)
+            {
+                unlocked |= 1 << c;
+            }
+        }
+        return unlocked;
+    }
+
+    cost_t hscore(const Node& node) const
+    {
+        size_t robot_cell = (node.player_coord_.y * floor_width) + node.player_coord_.x;
+        return get_hscore(robot_cell, unlocked_gates(node), node.gear_descriptor_.bitfield);
+    }
+
+    using HeuristicTerm<ShortestDistanceThroughGearsToExitHeuristic>::get_hscore;
+
+private:
+    // A shortest walk from a tile to a target that no other walk beats with
+    // as many gates unlocked on arrival
+    struct Leg
+    {
+        cost_t cost;
+        unsigned unlocked;
+    };
+
+    // \returns false if the table does not fit in table_bytes_max even
+    //          without gates; then no gate is kept.
+    bool find_gates(size_t table_bytes_max);
+    void compute_target_distances();
+    void compute_hscore_table();
+    void compute_target_to_target();
+
+    // Spanning tree bound, for levels without a table
+    cost_t mst_hscore(size_t cell, gears_bitfield_t gears_bitfield) const;
+
+    // Weight of the minimum spanning tree of the gears of gears_bitfield and
+    // the exit, or COST_INFINITY if they are not connected. Cached.
+    cost_t mst_weight(gears_bitfield_t gears_bitfield) const;
+
+    // Append the legs from cell to each target to legs; those to target t
+    // are legs[first[t]] up to legs[first[t + 1]]. row is scratch space for
+    // distances_from().
+    void find_legs(size_t cell, unsigned unlocked, cost_t* row,
+                   vector<Leg>& legs, size_t* first) const;
+
+    ShortestDistanceThroughGearsToExitHeuristic(const ShortestDistanceThroughGearsToExitHeuristic& other); // no copy
+    ShortestDistanceThroughGearsToExitHeuristic& operator=(const ShortestDistanceThroughGearsToExitHeuristic& other); // no copy
+};
+
+
+/**
+   \struct FirstPushHeuristic
+   \brief When boxes wall the player away from a gear that is left or the
+          exit: the cost of the cheapest first push, plus the walk after it.
+
+   If the player cannot reach every gear that is left and the exit without
+   moving a box, the solution has a first push. Before it nothing has moved,
+   so it is one of the pushes of the current state, made from the region the
+   player can walk in. After it the player stands where the box was, with at
+   least the gears outside of the region still to collect. The cheapest
+   walk to a push, plus the push, plus the walk table from there, is a lower
+   bound. Stack it on the walk with MaxHeuristic; a push is also a step of
+   the walk, so AddHeuristic would count it twice.
+
+   Finding the region costs several times more than the rest of a successor,
+   so the bound is only an expansion_hscore(); hscore() is 0.
+ */
+struct FirstPushHeuristic : public HeuristicTerm<FirstPushHeuristic>
+{
+    const Level& level;
+
+    const ShortestDistanceThroughGearsToExitHeuristic& walk;
+
+    FirstPushHeuristic(const Level& level, const ShortestDistanceThroughGearsToExitHeuristic& walk)
+        : level(level)
+        , walk(walk)
+    {
+    }
+
+    cost_t hscore(const Node&) const { return 0; }
+
+    // 0 if the player can reach every gear that is left and the exit
+    // without a push
+    cost_t expansion_hscore(const Node& node) const;
 };
 
 
@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "Level.h"
 #include "Node.h"
 
@@ -243,10 +245,261 @@ Level Level::MakeLevel(const vector<vector<char> >& charmap)
     }
   }
 
+  level.MakeBitboards();
   return level;
 }
 
 
+// Build the bitboards of the fixed parts of the level. Must be called again
+// if the floor plan, exit, gears or switches change.
+void Level::MakeBitboards()
+{
+  LevelBitboards& bb = bitboards_;
+  int height = (int)floor_plan_.size();
+  bb = LevelBitboards();
+  bb.width = height > 0 ? (int)floor_plan_[0].size() : 0;
+  bb.tiles = bb.width * height;
+  for (int y = 0; y < height; y++)
+  {
+    for (int x = 0; x < bb.width; x++)
+    {
+      int tile = y * bb.width + x;
+      char c = floor_plan_[y][x];
+      bb.board.Set(tile);
+      if (c == ' ')
+        bb.floor.Set(tile);
+      if (c == '\'' || c == 'x')
+        bb.boxing.Set(tile);
+      if (x > 0)
+        bb.not_left_column.Set(tile);
+      if (x < bb.width - 1)
+        bb.not_right_column.Set(tile);
+      if (y == 0)
+        bb.edge[0].Set(tile);
+      if (y == height - 1)
+        bb.edge[1].Set(tile);
+      if (x == 0)
+        bb.edge[2].Set(tile);
+      if (x == bb.width - 1)
+        bb.edge[3].Set(tile);
+    }
+  }
+  bb.exit = Bitboard::Tile(bb.TileIndex(exit_coord_));
+  for (const auto& gear : gear_coords_)
+  {
+    bb.gears.push_back(Bitboard::Tile(bb.TileIndex(gear)));
+  }
+  for (const auto& kv : switch_gate_pairs_)
+  {
+    bb.switches.push_back(Bitboard::Tile(bb.TileIndex(kv.second.first)));
+    bb.gates.push_back(Bitboard::Tile(bb.TileIndex(kv.second.second)));
+  }
+  FindDeadPushes();
+  FindTunnels();
+}
+
+
+// Tiles next to tile, in the order of EncodedPathDirection: up, right,
+// down, left. -1 where that side is off the level.
+static void neighbor_tiles(const LevelBitboards& bb, int tile, int* neighbors)
+{
+  int x = tile % bb.width;
+  neighbors[0] = (tile >= bb.width) ? tile - bb.width : -1;
+  neighbors[1] = (x < bb.width - 1) ? tile + 1 : -1;
+  neighbors[2] = (tile + bb.width < bb.tiles) ? tile + bb.width : -1;
+  neighbors[3] = (x > 0) ? tile - 1 : -1;
+}
+
+
+// Tarjan's depth first search below tile; adds the articulation points it
+// finds to points. order is 0 for tiles not visited yet.
+static void find_articulation_points(const LevelBitboards& bb, int tile, int parent,
+                                     int& time, vector<int>& order, vector<int>& low,
+                                     Bitboard& points)
+{
+  order[tile] = low[tile] = ++time;
+  int children = 0;
+  int neighbors[4];
+  neighbor_tiles(bb, tile, neighbors);
+  for (int d = 0; d < 4; d++)
+  {
+    int next = neighbors[d];
+    if (next < 0 || !bb.floor.Test(next) || next == parent)
+    {
+      continue;
+    }
+    if (order[next])
+    {
+      low[tile] = min(low[tile], order[next]);
+      continue;
+    }
+    children++;
+    find_articulation_points(bb, next, tile, time, order, low, points);
+    low[tile] = min(low[tile], low[next]);
+    if (parent >= 0 && low[next] >= order[tile])
+    {
+      points.Set(tile);
+    }
+  }
+  if (parent < 0 && children > 1)
+  {
+    points.Set(tile);
+  }
+}
+
+
+// Find the pushes that leave a box in a choke point for good, cutting the
+// player off from the exit or a gear. Called by MakeBitboards().
+void Level::FindDeadPushes()
+{
+  LevelBitboards& bb = bitboards_;
+
+  // The player pushes from the tile behind the box onto the tile ahead of
+  // it. The tile ahead may be any floor tile but the exit; a gear is
+  // collected before a box is pushed onto it.
+  Bitboard open = bb.floor.AndNot(bb.exit);
+  Bitboard gates;
+  for (size_t i = 0; i < bb.gates.size(); i++)
+  {
+    gates |= bb.gates[i];
+  }
+
+  vector<int> order(bb.tiles, 0);
+  vector<int> low(bb.tiles, 0);
+  int time = 0;
+  bb.articulation = Bitboard();
+  for (int tile = 0; tile < bb.tiles; tile++)
+  {
+    if (bb.floor.Test(tile) && !order[tile])
+    {
+      find_articulation_points(bb, tile, -1, time, order, low, bb.articulation);
+    }
+  }
+
+  // Only a box on an articulation point cuts the floor in two. The player
+  // stands on one side, after the push, and stays there for as long as the
+  // box does. Where it cannot push the box from there, that is for good.
+  bb.cut_gears.assign(bb.tiles * 4, 0);
+  Bitboard chokes = bb.articulation & open.AndNot(gates);
+  for (int tile = 0; tile < bb.tiles; tile++)
+  {
+    if (!chokes.Test(tile))
+    {
+      continue;
+    }
+    Bitboard walkable = bb.floor.AndNot(Bitboard::Tile(tile));
+    int neighbors[4];
+    neighbor_tiles(bb, tile, neighbors);
+    for (int d = 0; d < 4; d++)
+    {
+      // Pushed in direction d, the player ends up on the opposite side
+      int player = neighbors[(d + 2) % 4];
+      if (player < 0 || !walkable.Test(player))
+      {
+        continue;
+      }
+      Bitboard reached = Bitboard::Tile(player);
+      Bitboard frontier = reached;
+      while (frontier.Any())
+      {
+        frontier = bb.Neighbors(frontier).AndNot(reached) & walkable;
+        reached |= frontier;
+      }
+
+      bool stuck = true;
+      for (int e = 0; e < 4 && stuck; e++)
+      {
+        int from = neighbors[(e + 2) % 4];
+        int to = neighbors[e];
+        stuck = !(from >= 0 && reached.Test(from) && to >= 0 && open.Test(to));
+      }
+      if (!stuck)
+      {
+        continue;
+      }
+
+      if (!(reached & bb.exit).Any())
+      {
+        bb.cuts_exit[d].Set(tile);
+      }
+      for (size_t i = 0; i < bb.gears.size(); i++)
+      {
+        if (!(reached & bb.gears[i]).Any())
+        {
+          bb.cut_gears[tile * 4 + d] |= (gears_bitfield_t)1 << i;
+        }
+      }
+    }
+  }
+}
+
+
+
+// Finds the dead ends that a push can shut the player in. Only a box on an
+// articulation point shuts in anything.
+void Level::FindTunnels()
+{
+  LevelBitboards& bb = bitboards_;
+
+  Bitboard targets = bb.exit;
+  for (size_t i = 0; i < bb.gears.size(); i++)
+  {
+    targets |= bb.gears[i];
+  }
+  for (size_t i = 0; i < bb.switches.size(); i++)
+  {
+    targets |= bb.switches[i] | bb.gates[i];
+  }
+
+  bb.tunnel_behind.assign(bb.tiles * 4, Bitboard());
+  Bitboard boxes = bb.articulation.AndNot(targets);
+  for (int tile = 0; tile < bb.tiles; tile++)
+  {
+    if (!boxes.Test(tile))
+    {
+      continue;
+    }
+    Bitboard walkable = bb.floor.AndNot(Bitboard::Tile(tile));
+    int neighbors[4];
+    neighbor_tiles(bb, tile, neighbors);
+    for (int d = 0; d < 4; d++)
+    {
+      int player = neighbors[(d + 2) % 4];
+      if (player < 0 || !walkable.Test(player))
+      {
+        continue;
+      }
+      Bitboard reached = Bitboard::Tile(player);
+      Bitboard frontier = reached;
+      while (frontier.Any())
+      {
+        frontier = bb.Neighbors(frontier).AndNot(reached) & walkable;
+        reached |= frontier;
+      }
+      if ((reached & targets).Any())
+      {
+        continue;
+      }
+
+      // The player must not reach another side of the box either
+      bool behind = true;
+      for (int e = 0; e < 4; e++)
+      {
+        if (neighbors[e] >= 0 && neighbors[e] != player && reached.Test(neighbors[e]))
+        {
+          behind = false;
+        }
+      }
+      if (behind)
+      {
+        bb.tunnel[d].Set(tile);
+        bb.tunnel_behind[tile * 4 + d] = reached;
+      }
+    }
+  }
+}
+
+
 int Level::GearsLeft(const vector<vector<char> >& charmap)
 {
   int gearsLeft = 0;
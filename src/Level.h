@@ -3,6 +3,7 @@
 
 #include <map>
 #include <vector>
+#include "Bitboard.h"
 #include "boxedintypes.h"
 //#include "Node.h"
 
@@ -34,10 +35,19 @@ public:
   // The floor switch and corresponding gate for each color
   map<Color, pair<Coord, Coord> > switch_gate_pairs_;
 
+  // The fixed parts of the level as bitboards, used by the search
+  LevelBitboards bitboards_;
+
   vector<vector<char> > MakeFloodFillMap(const Node& node, bool draw_player) const;
 
   vector<vector<char> > Render() const;
 
+  void MakeBitboards();
+
+  void FindDeadPushes();
+
+  void FindTunnels();
+
   void TryPickupGear();
   void MoveUp();
   void MoveDown();
@@ -1,107 +1,211 @@
+#include <mutex>
+
 #include "Heuristic.h"
 #include "Node.h"
 
-using namespace boost;
+using namespace std;
 
 namespace boxedin
 {
 
 #if USE_NODE_MEMORY_POOL
-pool<default_user_allocator_new_delete> memory_pool(sizeof(Node), MEMORY_POOL_NCHUNKS_START_SIZE);
+static thread_local NodePool* thread_memory_pool = NULL;
+
+void SetThreadNodePool(NodePool* pool)
+{
+    thread_memory_pool = pool;
+}
+
+NodePool* GetThreadNodePool()
+{
+    return thread_memory_pool;
+}
+
+// Pool of the Nodes made while no pool is selected. Never destroyed, so
+// such Nodes can still be deleted during static destruction.
+static NodePool& process_memory_pool()
+{
+    static Arena* arena = new Arena();
+    static NodePool* pool = new NodePool(sizeof(Node), *arena);
+    return *pool;
+}
+
+static mutex process_memory_pool_mutex;
 #endif
 
 Node::Node(const Level& level, Heuristic& heuristic)
-    : predecessor_(NULL)
-    , player_coord_(level.player_coord_)
+    : hash_(0)
     , box_descriptor_(level.box_coords_,
                       level.floor_plan_[0].size(),
                       level.floor_plan_.size())
+    , player_coord_(level.player_coord_)
     , gear_descriptor_(level.gear_coords_)
-    , better_gscore_found_(false)
+    , predecessor_(NODE_INDEX_NONE)
+    , open_handle_(NODE_NOT_QUEUED)
     , gscore_(0)
-    , hscore_((cost_t)0)
+    , hscore_(0)
+    , direction_(ENCODED_PATH_DIRECTION_UP)
 {
-    hscore_ = heuristic.get_hscore(*this);
+    hash_ = ComputeHash(level);
+    set_hscore(heuristic.get_hscore(*this));
 }
 
-Node::Node(const Level& level, Heuristic& heuristic, Node& node, const Action& action)
-    : predecessor_(&node)
-    , path_(action.path)
-    , player_coord_(action.point)
+Node::Node(const Level& level, Heuristic& heuristic, Node& node, const ActionPoint& action)
+    : Node(level, node, action)
+{
+    set_hscore(heuristic.get_hscore(*this));
+}
+
+Node::Node(const Level& level, Node& node, const ActionPoint& action)
+    : hash_(node.hash_)
     , box_descriptor_(node.box_descriptor_)
+    , player_coord_(action.point)
     , gear_descriptor_(node.gear_descriptor_)
-    , better_gscore_found_(false)
-    , gscore_(node.gscore_ + action.path.size())
-    , hscore_((cost_t)0)
+    , predecessor_(NodeRegion::Index(&node, sizeof(Node)))
+    , open_handle_(NODE_NOT_QUEUED)
+    , gscore_(node.gscore_ + action.length)
+    , hscore_(0)
+    , direction_(action.direction)
 {
+    int floor_width = (int)level.floor_plan_[0].size();
+
+    hash_ ^= zobrist_player(node.player_coord_.y * floor_width + node.player_coord_.x);
+    hash_ ^= zobrist_player(player_coord_.y * floor_width + player_coord_.x);
+
     // If there is a gear at the action point, this will clear it.
-    gear_descriptor_.ClearGearBit( level.gear_coords_, action.point );
+    int gear_index = gear_descriptor_.ClearGearBit( level.gear_coords_, action.point );
+    if (gear_index >= 0)
+    {
+      hash_ ^= zobrist_gear(gear_index);
+    }
 
-    if (box_descriptor_.HasBoxAt( (int)level.floor_plan_[0].size(), action.point ) )
+    if (box_descriptor_.HasBoxAt( floor_width, action.point ) )
     {
-      EncodedPathDirection direction = action.path.at(action.path.size() - 1);
-      switch (direction)
+      Coord new_box_coord = action.point;
+      switch (action.direction)
       {
       case ENCODED_PATH_DIRECTION_UP:
-        box_descriptor_.MoveUp( (int)level.floor_plan_[0].size(), action.point );
+        box_descriptor_.MoveUp( floor_width, action.point );
+        new_box_coord.y--;
         break;
       case ENCODED_PATH_DIRECTION_DOWN:
-        box_descriptor_.MoveDown( (int)level.floor_plan_[0].size(), action.point );
+        box_descriptor_.MoveDown( floor_width, action.point );
+        new_box_coord.y++;
         break;
       case ENCODED_PATH_DIRECTION_LEFT:
-        box_descriptor_.MoveLeft( (int)level.floor_plan_[0].size(), action.point );
+        box_descriptor_.MoveLeft( floor_width, action.point );
+        new_box_coord.x--;
         break;
       case ENCODED_PATH_DIRECTION_RIGHT:
-        box_descriptor_.MoveRight( (int)level.floor_plan_[0].size(), action.point );
+        box_descriptor_.MoveRight( floor_width, action.point );
+        new_box_coord.x++;
         break;
       }
+      hash_ ^= zobrist_box(action.point.y * floor_width + action.point.x);
+      hash_ ^= zobrist_box(new_box_coord.y * floor_width + new_box_coord.x);
     }
-        
-    hscore_ = heuristic.get_hscore(*this);
 }
 
-#ifdef USE_NODE_MEMORY_POOL
-void* Node::operator new(size_t sz)
+Node::Node(const Level& level, Heuristic& heuristic, Node& node, const Action& action)
+    : Node(level, heuristic, node, ActionPoint(action))
 {
-    return memory_pool.malloc();
 }
 
-void Node::operator delete(void* p)
+void Node::KeyOnRegion(const Level& level, int region_tile)
 {
-    memory_pool.free(p);
+    int floor_width = (int)level.floor_plan_[0].size();
+    hash_ = ComputeHash(level);
+    hash_ ^= zobrist_player(player_coord_.y * floor_width + player_coord_.x);
+    hash_ ^= zobrist_player(region_tile);
 }
-#endif
 
-bool operator<(const BoxDescriptorLite& l, const BoxDescriptorLite& r)
+void Node::SwapHashedPlayerTile(int tile, int other_tile)
 {
-    for (size_t i = 0; i < l.size; i++)
+    hash_ ^= zobrist_player(tile) ^ zobrist_player(other_tile);
+}
+
+void Node::PushAgain(const Level& level)
+{
+    int floor_width = (int)level.floor_plan_[0].size();
+    Coord box = player_coord_;
+    switch (direction_)
     {
-        if (l.bitfields[i] == r.bitfields[i])
-        {
-            continue;
-        }
-        return (l.bitfields[i] < r.bitfields[i]);
+    case ENCODED_PATH_DIRECTION_UP:
+      box.y--;
+      box_descriptor_.MoveUp( floor_width, box );
+      break;
+    case ENCODED_PATH_DIRECTION_DOWN:
+      box.y++;
+      box_descriptor_.MoveDown( floor_width, box );
+      break;
+    case ENCODED_PATH_DIRECTION_LEFT:
+      box.x--;
+      box_descriptor_.MoveLeft( floor_width, box );
+      break;
+    case ENCODED_PATH_DIRECTION_RIGHT:
+      box.x++;
+      box_descriptor_.MoveRight( floor_width, box );
+      break;
     }
-    return false; // box descriptor bitfields have equal size and values
+    int player = player_coord_.y * floor_width + player_coord_.x;
+    int tile = box.y * floor_width + box.x;
+    int ahead = 2 * tile - player;
+    hash_ ^= zobrist_player(player) ^ zobrist_player(tile);
+    hash_ ^= zobrist_box(tile) ^ zobrist_box(ahead);
+    player_coord_ = box;
+    gscore_++;
 }
 
-bool operator==(const BoxDescriptorLite& l, const BoxDescriptorLite& r)
+uint64_t Node::ComputeHash(const Level& level) const
 {
-    for (size_t i = 0; i < l.size; i++)
+    int floor_width = (int)level.floor_plan_[0].size();
+    uint64_t hash = zobrist_player(player_coord_.y * floor_width + player_coord_.x);
+
+    for (int i = 0; i < box_descriptor_.size; i++)
     {
-        if (l.bitfields[i] == r.bitfields[i])
+        uint64_t bitfield = box_descriptor_.bitfields[i];
+        for (int bit_index = 0; bit_index < box_descriptor_.kBitfieldWidth; bit_index++)
         {
-            continue;
+            if (bitfield & ((uint64_t)1 << bit_index))
+            {
+                hash ^= zobrist_box(i * box_descriptor_.kBitfieldWidth + bit_index);
+            }
         }
-        return false;
     }
-    return true;
+
+    int num_gears = (int)level.gear_coords_.size();
+    for (int i = 0; i < num_gears; i++)
+    {
+        if (gear_descriptor_.bitfield & ((gears_bitfield_t)1 << i))
+        {
+            hash ^= zobrist_gear(i);
+        }
+    }
+
+    return hash;
 }
 
-bool operator<(const GearDescriptorLite& l, const GearDescriptorLite& r)
+#ifdef USE_NODE_MEMORY_POOL
+void* Node::operator new(size_t sz)
 {
-    return (l.bitfield < r.bitfield);
+    if (thread_memory_pool)
+    {
+        return thread_memory_pool->Allocate();
+    }
+    lock_guard<mutex> lock(process_memory_pool_mutex);
+    return process_memory_pool().Allocate();
 }
 
+void Node::operator delete(void* p)
+{
+    if (thread_memory_pool)
+    {
+        thread_memory_pool->Free(p);
+        return;
+    }
+    lock_guard<mutex> lock(process_memory_pool_mutex);
+    process_memory_pool().Free(p);
+}
+#endif
 
 } // namespace boxedin
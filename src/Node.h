@@ -1,20 +1,18 @@
 #ifndef BOXED_IN_NODE
 #define BOXED_IN_NODE
 
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include "boxedintypes.h"
 #include "EncodedPath.h"
-#include "Heuristic.h"
 #include "Level.h"
+#include "Zobrist.h"
 
 // Use memory pool for Node allocation?
 #define USE_NODE_MEMORY_POOL 1
 
-#if USE_NODE_MEMORY_POOL
-#include <boost/pool/pool.hpp>
-#define MEMORY_POOL_NCHUNKS_START_SIZE 4096
-#endif
+#include "Arena.h"
 
 using namespace std;
 
@@ -23,16 +21,66 @@ namespace boxedin
 
 struct Heuristic; // forward
 
+#if USE_NODE_MEMORY_POOL
+/**
+   \brief Select the pool that Node::operator new and delete use on the
+          calling thread.
+   \param[in] pool The pool, or NULL to use the process-wide pool. That one
+              is locked on every call and never gives its memory back; it is
+              meant for the few Nodes made outside of a search.
+   \details A pool is not thread safe. Each search owns its pools (a
+            multi-threaded search has one per worker thread) and keeps them
+            alive until every thread has finished, because a Node may be
+            deleted by a different thread than the one that created it. When
+            the search is destroyed, its pools free every Node at once.
+ */
+void SetThreadNodePool(NodePool* pool);
+
+/** \returns The pool selected on the calling thread, or NULL. */
+NodePool* GetThreadNodePool();
+
+/**
+   \class ScopedNodePool
+   \brief Selects a pool on the calling thread for the lifetime of the
+          object, then restores the previous one.
+ */
+class ScopedNodePool
+{
+public:
+    explicit ScopedNodePool(NodePool* pool)
+        : previous_(GetThreadNodePool())
+    {
+        SetThreadNodePool(pool);
+    }
+
+    ~ScopedNodePool()
+    {
+        SetThreadNodePool(previous_);
+    }
+
+private:
+    NodePool* previous_;
+
+    ScopedNodePool(const ScopedNodePool& other); // no copy
+    ScopedNodePool& operator=(const ScopedNodePool& other); // no copy
+};
+#endif
+
 
 // TODO: Needs documentation. I don't remember what this was for.
 //       Lose the stupid "Lite" nomenclature.
-struct BoxDescriptorLite
+//
+// The boxes of a state, one bit per tile in WORDS 64-bit words. The word
+// count is a template parameter so that compares and copies are unrolled;
+// Node uses BOARD_WORDS (see config.h).
+template <int WORDS>
+struct BoxDescriptor
 {
-    static const int size = 3;
+    static const int size = WORDS;
     uint64_t bitfields[size];
     static const int kBitfieldWidth = (sizeof(uint64_t) * 8);
 
-    BoxDescriptorLite(const vector<Coord>& box_coords, size_t floor_width, size_t floor_height)
+    BoxDescriptor(const vector<Coord>& box_coords, size_t floor_width, size_t floor_height)
     {
         for (size_t i = 0; i < size; i++)
         {
@@ -118,39 +166,59 @@ struct BoxDescriptorLite
     }
 };
 
+template <int WORDS>
+const int BoxDescriptor<WORDS>::size;
 
-struct GearDescriptorLite
+typedef BoxDescriptor<BOARD_WORDS> BoxDescriptorLite;
+
+
+// The gears of a state that have not been picked up, one bit per gear in a
+// Bitfield (an unsigned integer type). Node uses gears_bitfield_t (see
+// GEARS_MAX in config.h).
+template <class Bitfield>
+struct GearDescriptor
 {
-    uint16_t bitfield;
+    typedef Bitfield bitfield_type;
 
-    GearDescriptorLite()
+    Bitfield bitfield;
+
+    GearDescriptor()
         : bitfield(0)
     {
     }
     
-    GearDescriptorLite(const vector<Coord>& gear_coords)
+    GearDescriptor(const vector<Coord>& gear_coords)
         : bitfield(0)
     {
         for (size_t i = 0; i < gear_coords.size(); i++)
         {
-            bitfield |= ((uint16_t)1 << i);
+            bitfield |= ((Bitfield)1 << i);
         }
     }
 
-    void ClearGearBit( const vector<Coord>& gear_coords, const Coord& clear_coord )
+    // Returns the index of the gear that was cleared or -1 if there is no
+    // gear at clear_coord.
+    int ClearGearBit( const vector<Coord>& gear_coords, const Coord& clear_coord )
     {
         int sz = (int)gear_coords.size();
         for (int i = 0; i < sz; i++)
         {
             if (gear_coords[i] == clear_coord)
             {
-                bitfield &= ~(1 << i);
+                if (bitfield & ((Bitfield)1 << i))
+                {
+                    bitfield &= ~((Bitfield)1 << i);
+                    return i;
+                }
                 break;
             }
         }
+        return -1;
     }
 };
 
+typedef GearDescriptor<gears_bitfield_t> GearDescriptorLite;
+
 
 struct Action
 {
@@ -194,43 +262,130 @@ struct Action
 };
 
 
+/**
+   \struct ActionPoint
+   \brief An Action without its path: the point the player moves to, how many
+          moves it takes and the direction of the last move (the direction of
+          the push if there is a box at point).
+
+   The search only needs these to make a successor. The path is rebuilt with
+   find_path() once a solution has been found.
+ */
+struct ActionPoint
+{
+    Coord point;
+    uint8_t direction;   // EncodedPathDirection
+    tile_index_t length; // a path never visits a tile twice, so fewer moves than tiles
+
+    ActionPoint()
+        : direction(ENCODED_PATH_DIRECTION_UP)
+        , length(0)
+    {
+    }
+    ActionPoint(const Coord& point, EncodedPathDirection direction, int length)
+        : point(point)
+        , direction((uint8_t)direction)
+        , length((tile_index_t)length)
+    {
+    }
+    explicit ActionPoint(const Action& action)
+        : point(action.point)
+        , direction(action.path.size() ? (uint8_t)action.path.at(action.path.size() - 1)
+                                       : (uint8_t)ENCODED_PATH_DIRECTION_UP)
+        , length(action.path.size())
+    {
+    }
+};
+
+
+// Node::open_handle_ of a Node that is not in a BucketQueue
+#define NODE_NOT_QUEUED UINT32_MAX
+
+// Largest gscore and hscore a Node can hold. Larger hscores (e.g.
+// COST_INFINITY of a dead state) are stored as this, which is still larger
+// than any fscore the searches accept.
+#define NODE_COST_MAX 0x3FFF
+
+/**
+   \class Node
+   \brief A state of the level and how the search reached it.
+
+   A search holds millions of Nodes, so they are packed into 48 bytes: the
+   predecessor is a 32-bit NodeRegion index instead of a pointer, the scores
+   are 16 bits wide and the direction shares a word with the hscore. The
+   fields that are read together when a Node is expanded or looked up (hash
+   and boxes) come first.
+ */
 class Node
 {
 public:
-    // Pointer to the Node that spawned this Node; NULL for the beginning Node
-    Node* predecessor_;
-
-    EncodedPath path_;
+    // Zobrist hash of the fields that uniquely identify the Node. It is
+    // computed once for the start Node and updated incrementally for each
+    // successor.
+    uint64_t hash_;
 
     /** \name Fields that uniquely identify the Node */
 /**@{*/
+    BoxDescriptorLite box_descriptor_;
+
     // The current coordinate of the player
     Coordinate<uint8_t> player_coord_;
 
-    BoxDescriptorLite box_descriptor_;
-    
     GearDescriptorLite gear_descriptor_;
 /**@}*/
 
-    // This implementation of A* does not update the gscore of a Node when a
-    // better gscore is found. This is because Nodes are stored in a vector
-    // of list<Node*> where each vector index is the fscore (gscore+hscore).
-    // To update the gscore of the Node would also require that the Node* be
-    // removed from its list<Node*> and inserted into another (unnecessarily
-    // expensive). Instead, when a better gscore is found, this flag is set
-    // and a new Node* is added to the appropriate list<Node*> in the vector.
-    // Later, when A* removes this node from openset_fscore_nodes, this flag
-    // is checked and the Node is destroyed.
-    bool better_gscore_found_;
+    // NodeRegion index of the Node that spawned this Node; NODE_INDEX_NONE
+    // for the beginning Node (or a parent that is not in the NodeRegion, such
+    // as a Node on the stack). See predecessor().
+    uint32_t predecessor_;
+
+    // Position of this Node in the BucketQueue that holds it, or
+    // NODE_NOT_QUEUED. When a state is reached with a better gscore, the
+    // search uses it to remove the old Node from the open set in constant
+    // time.
+    uint32_t open_handle_;
+
+    uint16_t gscore_; // cost from start to this node
+
+    // estimated cost form this node to goal, at most NODE_COST_MAX
+    uint16_t hscore_ : 14;
 
-    cost_t gscore_; // cost from start to this node
-    cost_t hscore_; // estimated cost form this node to goal
+    // Direction of the last move of the action that made this Node. With
+    // player_coord_ it identifies the action, so find_path() can rebuild its
+    // path from the predecessor.
+    uint16_t direction_ : 2;
 
     Node(const Level& level, Heuristic& heuristic);
 
+    Node(const Level& level, Heuristic& heuristic, Node& node, const ActionPoint& action);
+
+    // Successor with an hscore of 0, to be set with Heuristic::set_hscores()
+    Node(const Level& level, Node& node, const ActionPoint& action);
+
     Node(const Level& level, Heuristic& heuristic, Node& node, const Action& action);
 
-    cost_t fscore() const { return gscore_ + hscore_; }
+    cost_t fscore() const { return (cost_t)gscore_ + hscore_; }
+
+    /** \returns The Node that spawned this Node, or NULL. */
+    Node* predecessor() const
+    {
+        if (predecessor_ == NODE_INDEX_NONE)
+        {
+            return NULL;
+        }
+        return (Node*)NodeRegion::At(predecessor_, sizeof(Node));
+    }
+
+    void set_predecessor(const Node* node)
+    {
+        predecessor_ = node ? NodeRegion::Index(node, sizeof(Node)) : NODE_INDEX_NONE;
+    }
+
+    /** Set the hscore, saturated to NODE_COST_MAX */
+    void set_hscore(cost_t hscore)
+    {
+        hscore_ = (hscore > NODE_COST_MAX) ? NODE_COST_MAX : hscore;
+    }
     
     static Node* MakeStartNode(const Level& level, Heuristic& heuristic)
     {
@@ -243,6 +398,23 @@ public:
         return (gear_descriptor_.bitfield == 0) && (player_coord_ == level.exit_coord_);
     }
 
+    // Compute the Zobrist hash of this Node from scratch.
+    uint64_t ComputeHash(const Level& level) const;
+
+    // Hash the Node with region_tile in place of the tile of the player, so
+    // that every Node whose player is in the same region lands in the same
+    // TranspositionTable slot. See TranspositionTable::InsertInRegion().
+    void KeyOnRegion(const Level& level, int region_tile);
+
+    // Swap tile for other_tile in hash_; e.g. key a successor on its region
+    // without hashing it from scratch.
+    void SwapHashedPlayerTile(int tile, int other_tile);
+
+    // Push the box in front of the player one more tile in direction_, as
+    // the successor of this Node would, and take its place. Used to follow
+    // a push through a tunnel without making a Node for every tile of it.
+    void PushAgain(const Level& level);
+
 #ifdef USE_NODE_MEMORY_POOL
     void* operator new(size_t sz);
 
@@ -250,11 +422,60 @@ public:
 #endif
 };
 
+#if BOARD_TILES_MAX == 192 && GEARS_MAX <= GEARS_16
+static_assert(sizeof(Node) == 48, "Node is packed into 48 bytes");
+#endif
+
 
 
-bool operator<(const BoxDescriptorLite& l, const BoxDescriptorLite& r);
-bool operator==(const BoxDescriptorLite& l, const BoxDescriptorLite& r);
-bool operator<(const GearDescriptorLite& l, const GearDescriptorLite& r);
+template <int WORDS>
+inline bool operator<(const BoxDescriptor<WORDS>& l, const BoxDescriptor<WORDS>& r)
+{
+    for (int i = 0; i < WORDS; i++)
+    {
+        if (l.bitfields[i] == r.bitfields[i])
+        {
+            continue;
+        }
+        return (l.bitfields[i] < r.bitfields[i]);
+    }
+    return false; // box descriptor bitfields have equal size and values
+}
+
+template <int WORDS>
+inline bool operator==(const BoxDescriptor<WORDS>& l, const BoxDescriptor<WORDS>& r)
+{
+    uint64_t difference = 0;
+    for (int i = 0; i < WORDS; i++)
+    {
+        difference |= l.bitfields[i] ^ r.bitfields[i];
+    }
+    return difference == 0;
+}
+
+template <class Bitfield>
+inline bool operator<(const GearDescriptor<Bitfield>& l, const GearDescriptor<Bitfield>& r)
+{
+    return (l.bitfield < r.bitfield);
+}
+
+
+// True if both Nodes have the same player coordinate, boxes and gears.
+inline bool SameState(const Node& l, const Node& r)
+{
+    return (l.player_coord_ == r.player_coord_) &&
+           (l.box_descriptor_ == r.box_descriptor_) &&
+           (l.gear_descriptor_.bitfield == r.gear_descriptor_.bitfield);
+}
+
+
+/**
+   \brief Rebuild the path of the action that made successor from node.
+   \details Floods node again, so it is meant for solutions, not for the
+            search. Defined in astar.cc with find_actions().
+   \throws std::runtime_error if no action of node makes successor.
+ */
+EncodedPath find_path(const Level& level, const Node& node, const Node& successor);
 
 
 struct NodeCompare
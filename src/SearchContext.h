@@ -0,0 +1,85 @@
+/**
+ * \file SearchContext.h
+ * \brief Everything one A* search allocates.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ */
+#ifndef SEARCH_CONTEXT_H__
+#define SEARCH_CONTEXT_H__
+
+#include "config.h"
+#include "astar.h"
+#include "Arena.h"
+#include "BucketQueue.h"
+#include "DeadlockPatterns.h"
+#include "Node.h"
+#include "TranspositionTable.h"
+
+namespace boxedin
+{
+
+/**
+   \class SearchContext
+   \brief The arena, Node pool, transposition table, open set and successor
+          storage of one A* search.
+
+   Searches that use different contexts share nothing, so they can run at the
+   same time on different threads. All of the memory comes from the context's
+   Arena and is released at once when the context is destroyed. Reset() keeps
+   the memory for the next search.
+ */
+class SearchContext
+{
+public:
+    /** \param[in] huge_pages Back the Arena with 2 MB pages. */
+    explicit SearchContext(bool huge_pages = false)
+        : arena_(huge_pages)
+        , pool_(sizeof(Node), arena_)
+        , table_(1 << 16, &arena_)
+        , open_(MAX_FSCORE, BucketQueue::TIE_BREAK_LOW_H_LIFO, &arena_)
+        , actions_(ArenaAllocator<ActionPoint>(&arena_, Arena::CATEGORY_SUCCESSORS))
+        , successors_(ArenaAllocator<Node*>(&arena_, Arena::CATEGORY_SUCCESSORS))
+        , patterns_(NULL)
+    {
+    }
+
+    /** Free every Node and empty the tables so another search can start. */
+    void Reset()
+    {
+        open_.Clear();
+        table_.Clear();
+        pool_.Reset();
+    }
+
+    const Arena& arena() const { return arena_; }
+    NodePool& pool() { return pool_; }
+    TranspositionTable& table() { return table_; }
+    BucketQueue& open() { return open_; }
+    ActionVector& actions() { return actions_; }
+    NodeVector& successors() { return successors_; }
+
+    /**
+       \brief Learn and prune deadlock patterns in the searches of this
+              context. The context does not own patterns; NULL turns it off.
+     */
+    void set_patterns(DeadlockPatterns* patterns) { patterns_ = patterns; }
+    DeadlockPatterns* patterns() { return patterns_; }
+
+private:
+    // Declared first so that it outlives everything it holds
+    Arena arena_;
+    NodePool pool_;
+    TranspositionTable table_;
+    BucketQueue open_;
+    ActionVector actions_;
+    NodeVector successors_;
+    DeadlockPatterns* patterns_;
+
+    SearchContext(const SearchContext& other); // no copy
+    SearchContext& operator=(const SearchContext& other); // no copy
+};
+
+} // namespace boxedin
+
+#endif
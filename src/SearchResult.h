@@ -9,14 +9,46 @@
 #define SEARCH_RESULT_H__
 
 #include <cstddef>
+#include <stdint.h>
 #include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
 #include "memusage.h"
+#include "Arena.h"
 #include "boxedintypes.h"
 #include "Node.h"
 #include "EncodedPath.h"
 
 namespace boxedin {
 
+    /**
+       \struct PruneCounts
+       \brief What generate_successors() pruned
+     */
+    struct PruneCounts
+    {
+        // Expansions with no successors because is_unsolvable()
+        uint64_t unsolvable;
+        // Successors not made because is_dead_push()
+        uint64_t dead_pushes;
+        // Successors not made because DeadlockPatterns::IsDeadPush()
+        uint64_t dead_patterns;
+        // States skipped by push_through_tunnel()
+        uint64_t tunnel_states;
+
+        PruneCounts() : unsolvable(0), dead_pushes(0), dead_patterns(0), tunnel_states(0) {}
+
+        PruneCounts& operator+=(const PruneCounts& other)
+        {
+            unsolvable += other.unsolvable;
+            dead_pushes += other.dead_pushes;
+            dead_patterns += other.dead_patterns;
+            tunnel_states += other.tunnel_states;
+            return *this;
+        }
+    };
+
     /**
        \class SearchResult
        \brief A* search results, statistics, possibly a solution
@@ -28,20 +60,49 @@ namespace boxedin {
         int num_moves;
         size_t openset_size;
         size_t closedset_size;
+        uint64_t nodes_expanded;
+        uint64_t last_layer_expanded; // nodes expanded with the solution's fscore
+        // States dropped or replaced because their player could walk to (or
+        // from) the player of a known state; A* with merge_regions only
+        uint64_t states_merged;
+        PruneCounts pruned;
+        // Proven upper bound on num_moves divided by the optimal number of
+        // moves; 1 for an optimal search.
+        double suboptimality_bound;
         std::chrono::steady_clock::time_point search_start_time;
         std::chrono::steady_clock::time_point search_stop_time;
         std::string solution; // if search succeeded
         MemUsage memusage;
+        // Bytes the search held in each Arena category, if it used an Arena
+        std::vector<std::pair<std::string, size_t> > arena_bytes;
+        size_t arena_mapped;
 
         SearchResult()
             : success(false)
             , num_moves(-1)
             , openset_size(0)
             , closedset_size(0)
+            , nodes_expanded(0)
+            , last_layer_expanded(0)
+            , states_merged(0)
+            , suboptimality_bound(1.0)
+            , arena_mapped(0)
         {
             search_start_time = std::chrono::steady_clock::now();
         }
 
+        void SetArenaUsage(const Arena& arena)
+        {
+            arena_bytes.clear();
+            for (int i = 0; i < Arena::CATEGORY_COUNT; i++)
+            {
+                Arena::Category category = (Arena::Category)i;
+                arena_bytes.push_back(std::make_pair(std::string(Arena::CategoryName(category)),
+                                                     arena.bytes(category)));
+            }
+            arena_mapped = arena.mapped();
+        }
+
         void SetFailed(size_t openset_size, size_t closedset_size)
         {
             search_stop_time = std::chrono::steady_clock::now();
@@ -51,7 +112,12 @@ namespace boxedin {
 
             GetMemUsage(memusage);
         }
-        void SetSucceeded(const Node* node, size_t openset_size, size_t closedset_size)
+        /**
+           \brief Record a solution that ends at node.
+           \details Nodes do not keep the paths of their actions, so the path
+                    from each Node to the next is rebuilt with find_path().
+         */
+        void SetSucceeded(const Level& level, const Node* node, size_t openset_size, size_t closedset_size)
         {
             search_stop_time = std::chrono::steady_clock::now();
             success = true;
@@ -61,13 +127,15 @@ namespace boxedin {
             GetMemUsage(memusage);
 
             num_moves = 0;
-            while (node)
+            solution.clear();
+            while (node && node->predecessor())
             {
-                num_moves += (int)node->path_.size();
+                EncodedPath path = find_path(level, *node->predecessor(), *node);
+                num_moves += (int)path.size();
                 string nodepath;
-                for (int i = 0; i < (int)node->path_.size(); i++)
+                for (int i = 0; i < (int)path.size(); i++)
                 {
-                    switch (node->path_.at(i))
+                    switch (path.at(i))
                     {
                     case ENCODED_PATH_DIRECTION_UP:
                         nodepath.push_back('U');
@@ -84,7 +152,7 @@ namespace boxedin {
                     }
                 }
                 solution = nodepath + solution;
-                node = node->predecessor_;
+                node = node->predecessor();
             }
         }
     };
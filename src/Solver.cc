@@ -0,0 +1,28 @@
+/**
+ * \file Solver.cc
+ * \brief Reentrant A* solver for one Boxed In level.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ */
+
+#include "Solver.h"
+#include "astar.h"
+
+using namespace std;
+
+namespace boxedin {
+
+Solver::Solver(const Level& level)
+    : level_(level)
+    , heuristic_(level_)
+{
+}
+
+
+SearchResult Solver::Solve(BucketQueue::TieBreaking tie_breaking)
+{
+    return astar(context_, level_, heuristic_, tie_breaking);
+}
+
+} // namespace boxedin
@@ -0,0 +1,55 @@
+/**
+ * \file Solver.h
+ * \brief Reentrant A* solver for one Boxed In level.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ */
+#ifndef SOLVER_H__
+#define SOLVER_H__
+
+#include "BucketQueue.h"
+#include "Heuristic.h"
+#include "Level.h"
+#include "SearchContext.h"
+#include "SearchResult.h"
+
+namespace boxedin
+{
+
+/**
+   \class Solver
+   \brief Owns a copy of a level, its heuristic and the SearchContext of the
+          A* search that solves it.
+
+   A Solver shares no state with any other Solver, so a process can solve
+   many levels at once by running one Solver per thread. All memory the search
+   used is freed when the Solver is destroyed.
+ */
+class Solver
+{
+public:
+    explicit Solver(const Level& level);
+
+    /**
+       \brief Run A* on the level. May be called again; the Nodes of the
+              previous search are freed first.
+     */
+    SearchResult Solve(BucketQueue::TieBreaking tie_breaking = BucketQueue::TIE_BREAK_LOW_H_LIFO);
+
+    const Level& level() const { return level_; }
+    Heuristic& heuristic() { return heuristic_; }
+
+private:
+    // The heuristic keeps a reference to level_, so level_ is declared first
+    Level level_;
+    ShortestDistanceThroughGearsToExitHeuristic heuristic_;
+    SearchContext context_;
+
+    Solver(const Solver& other); // no copy
+    Solver& operator=(const Solver& other); // no copy
+};
+
+} // namespace boxedin
+
+#endif
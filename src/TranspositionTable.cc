@@ -0,0 +1,344 @@
+/**
+ * \file TranspositionTable.cc
+ * \brief Hash table of the Nodes seen by the A* search.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ */
+#include <string.h>
+
+#include "TranspositionTable.h"
+
+namespace boxedin
+{
+
+// Grow the table when it is more than 7/10 full. Linear probing degrades
+// quickly above that.
+#define TRANSPOSITION_TABLE_MAX_LOAD_NUM 7
+#define TRANSPOSITION_TABLE_MAX_LOAD_DEN 10
+
+
+TranspositionTable::TranspositionTable(size_t initial_capacity, Arena* arena)
+    : arena_(arena)
+    , entries_(NULL)
+    , capacity_(16)
+    , open_size_(0)
+    , closed_size_(0)
+    , merged_(0)
+{
+    while (capacity_ < initial_capacity)
+    {
+        capacity_ <<= 1;
+    }
+    mask_ = capacity_ - 1;
+    entries_ = NewEntries(capacity_);
+}
+
+
+TranspositionTable::~TranspositionTable()
+{
+    DeleteEntries(entries_, capacity_);
+}
+
+
+// Returns capacity zeroed entries
+TranspositionTable::Entry* TranspositionTable::NewEntries(size_t capacity)
+{
+    Entry* entries = NULL;
+    if (arena_)
+    {
+        entries = (Entry*)arena_->Allocate(capacity * sizeof(Entry),
+                                           Arena::CATEGORY_TRANSPOSITION_TABLE);
+    }
+    else
+    {
+        entries = new Entry[capacity];
+    }
+    memset(entries, 0, capacity * sizeof(Entry));
+    return entries;
+}
+
+
+void TranspositionTable::DeleteEntries(Entry* entries, size_t capacity)
+{
+    if (arena_)
+    {
+        arena_->Free(entries, capacity * sizeof(Entry), Arena::CATEGORY_TRANSPOSITION_TABLE);
+    }
+    else
+    {
+        delete[] entries;
+    }
+}
+
+
+// Returns the index of the entry holding the state of node, or the index of
+// the empty entry where it would be inserted.
+size_t TranspositionTable::FindSlot(const Node& node) const
+{
+    uint64_t key = MakeKey(node.hash_);
+    size_t i = (size_t)(node.hash_ >> 1) & mask_;
+    for (;;)
+    {
+        const Entry& entry = entries_[i];
+        if (entry.node == NULL)
+        {
+            return i;
+        }
+        if (MakeKey(entry.key) == key && SameState(*entry.node, node))
+        {
+            return i;
+        }
+        i = (i + 1) & mask_;
+    }
+}
+
+
+TranspositionTable::InsertResult TranspositionTable::Insert(Node* node, Node** previous)
+{
+    size_t i = FindSlot(*node);
+    Entry& entry = entries_[i];
+
+    if (entry.node == NULL)
+    {
+        InsertAt(i, node);
+        return INSERTED;
+    }
+
+    if (entry.key & kClosedBit)
+    {
+        return DUPLICATE_CLOSED;
+    }
+
+    if (node->gscore_ < entry.node->gscore_)
+    {
+        if (previous)
+        {
+            *previous = entry.node;
+        }
+        entry.node = node;
+        return IMPROVED;
+    }
+
+    return DUPLICATE_OPEN;
+}
+
+
+// Steps from tile from to tile to, walking in region
+static cost_t RegionDistance(const LevelBitboards& bb, const Bitboard& region, int from, int to)
+{
+    Bitboard reached = Bitboard::Tile(from);
+    Bitboard frontier = reached;
+    cost_t distance = 0;
+    while (!reached.Test(to))
+    {
+        frontier = bb.Neighbors(frontier).AndNot(reached) & region;
+        if (!frontier.Any())
+        {
+            return COST_INFINITY;
+        }
+        reached |= frontier;
+        distance++;
+    }
+    return distance;
+}
+
+
+TranspositionTable::InsertResult TranspositionTable::InsertInRegion(Node* node, const Bitboard& region,
+                                                                    const LevelBitboards& bb, Node** previous)
+{
+    // Every Node of the region has the same key, so they are all on the
+    // probe sequence before the first empty entry
+    uint64_t key = MakeKey(node->hash_);
+    int player = bb.TileIndex(node->player_coord_);
+    size_t same = capacity_;    // the entry of the state of node
+    size_t replace = capacity_; // an open entry that node makes redundant
+    size_t i = (size_t)(node->hash_ >> 1) & mask_;
+    for (; entries_[i].node != NULL; i = (i + 1) & mask_)
+    {
+        const Entry& entry = entries_[i];
+        const Node& other = *entry.node;
+        if (MakeKey(entry.key) != key ||
+            !(other.box_descriptor_ == node->box_descriptor_) ||
+            other.gear_descriptor_.bitfield != node->gear_descriptor_.bitfield)
+        {
+            continue;
+        }
+        int tile = bb.TileIndex(other.player_coord_);
+        if (!region.Test(tile))
+        {
+            continue;
+        }
+        cost_t distance = RegionDistance(bb, region, player, tile);
+        if (distance == COST_INFINITY)
+        {
+            continue;
+        }
+        if (other.gscore_ + distance <= node->gscore_)
+        {
+            if (tile != player)
+            {
+                merged_++;
+            }
+            return (entry.key & kClosedBit) ? DUPLICATE_CLOSED : DUPLICATE_OPEN;
+        }
+        if (tile == player)
+        {
+            same = i;
+        }
+        else if (replace == capacity_ && !(entry.key & kClosedBit) &&
+                 node->gscore_ + distance <= other.gscore_)
+        {
+            replace = i;
+        }
+    }
+
+    // A state is in the table once, so that Close() finds it. Its own entry
+    // is handled as Insert() would.
+    if (same != capacity_)
+    {
+        if (entries_[same].key & kClosedBit)
+        {
+            return DUPLICATE_CLOSED;
+        }
+        replace = same;
+    }
+    else if (replace != capacity_)
+    {
+        merged_++;
+    }
+
+    if (replace != capacity_)
+    {
+        if (previous)
+        {
+            *previous = entries_[replace].node;
+        }
+        entries_[replace].node = node;
+        return IMPROVED;
+    }
+
+    InsertAt(i, node);
+    return INSERTED;
+}
+
+
+void TranspositionTable::InsertAt(size_t i, Node* node)
+{
+    entries_[i].node = node;
+    entries_[i].key = MakeKey(node->hash_);
+    open_size_++;
+    if (size() * TRANSPOSITION_TABLE_MAX_LOAD_DEN > capacity_ * TRANSPOSITION_TABLE_MAX_LOAD_NUM)
+    {
+        Grow();
+    }
+}
+
+
+bool TranspositionTable::Close(const Node* node)
+{
+    Entry& entry = entries_[FindSlot(*node)];
+    if (entry.node != node || (entry.key & kClosedBit))
+    {
+        return false;
+    }
+    entry.key |= kClosedBit;
+    open_size_--;
+    closed_size_++;
+    return true;
+}
+
+
+bool TranspositionTable::Erase(const Node* node)
+{
+    size_t i = FindSlot(*node);
+    if (entries_[i].node != node || (entries_[i].key & kClosedBit))
+    {
+        return false;
+    }
+    open_size_--;
+
+    // Move back the entries after i whose probe sequence passes i, so that
+    // no probe stops at the hole early
+    for (size_t j = (i + 1) & mask_; entries_[j].node != NULL; j = (j + 1) & mask_)
+    {
+        size_t home = (size_t)(entries_[j].node->hash_ >> 1) & mask_;
+        if (((j - home) & mask_) >= ((j - i) & mask_))
+        {
+            entries_[i] = entries_[j];
+            i = j;
+        }
+    }
+    entries_[i].node = NULL;
+    entries_[i].key = 0;
+    return true;
+}
+
+
+bool TranspositionTable::Reopen(Node* node)
+{
+    Entry& entry = entries_[FindSlot(*node)];
+    if (entry.node == NULL || !(entry.key & kClosedBit) ||
+        node->gscore_ >= entry.node->gscore_)
+    {
+        return false;
+    }
+    entry.node = node;
+    entry.key &= ~kClosedBit;
+    closed_size_--;
+    open_size_++;
+    return true;
+}
+
+
+void TranspositionTable::Clear()
+{
+    memset(entries_, 0, capacity_ * sizeof(Entry));
+    open_size_ = 0;
+    closed_size_ = 0;
+    merged_ = 0;
+}
+
+
+Node* TranspositionTable::Find(const Node& node) const
+{
+    return entries_[FindSlot(node)].node;
+}
+
+
+bool TranspositionTable::IsClosed(const Node& node) const
+{
+    const Entry& entry = entries_[FindSlot(node)];
+    return (entry.node != NULL) && (entry.key & kClosedBit);
+}
+
+
+void TranspositionTable::Grow()
+{
+    Entry* old_entries = entries_;
+    size_t old_capacity = capacity_;
+
+    capacity_ <<= 1;
+    mask_ = capacity_ - 1;
+    entries_ = NewEntries(capacity_);
+
+    for (size_t j = 0; j < old_capacity; j++)
+    {
+        const Entry& old_entry = old_entries[j];
+        if (old_entry.node == NULL)
+        {
+            continue;
+        }
+        // States are unique in the table, so only an empty slot is needed.
+        size_t i = (size_t)(old_entry.node->hash_ >> 1) & mask_;
+        while (entries_[i].node != NULL)
+        {
+            i = (i + 1) & mask_;
+        }
+        entries_[i] = old_entry;
+    }
+
+    DeleteEntries(old_entries, old_capacity);
+}
+
+} // namespace boxedin
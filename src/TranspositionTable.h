@@ -0,0 +1,158 @@
+/**
+ * \file TranspositionTable.h
+ * \brief Hash table of the Nodes seen by the A* search.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ */
+#ifndef TRANSPOSITION_TABLE_H__
+#define TRANSPOSITION_TABLE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "Arena.h"
+#include "Bitboard.h"
+#include "Node.h"
+
+namespace boxedin
+{
+
+/**
+   \class TranspositionTable
+   \brief Open-addressing (linear probing) hash table keyed by Node::hash_.
+
+   The table replaces the open set and closed set std::set containers. Every
+   state the search has seen is stored exactly once along with a flag that
+   says whether it is in the open set or the closed set. Each entry is 16
+   bytes and entries are stored contiguously, so a lookup is normally one
+   cache miss instead of a pointer chase through a red-black tree.
+
+   The table does not own the Nodes it points to. The entries come from the
+   Arena given to the constructor, or from the heap if there is none.
+ */
+class TranspositionTable
+{
+public:
+    /** Result of TranspositionTable::Insert() */
+    enum InsertResult
+    {
+        INSERTED,          /**< new state; added to the open set */
+        IMPROVED,          /**< open state reached with a better gscore; replaced */
+        DUPLICATE_OPEN,    /**< open state reached with no better gscore */
+        DUPLICATE_CLOSED   /**< state has already been evaluated */
+    };
+
+    explicit TranspositionTable(size_t initial_capacity = 1 << 16, Arena* arena = NULL);
+    ~TranspositionTable();
+
+    /**
+       \brief Insert node into the open set unless its state is already known.
+       \param[in] node The Node to insert.
+       \param[out] previous Set to the replaced Node if the result is IMPROVED.
+       \returns What was done with node. The caller still owns node unless the
+                result is INSERTED or IMPROVED.
+     */
+    InsertResult Insert(Node* node, Node** previous);
+
+    /**
+       \brief Insert node unless a Node with the same boxes and gears, whose
+              player stands in the same region, makes it redundant.
+
+       A Node whose player can walk to the player of node in d steps, and
+       whose gscore plus d is no more than that of node, reaches everything
+       node does at no more cost; node is dropped. If node is that much
+       cheaper than an open Node, it replaces it. Otherwise both are kept,
+       as two entry points into the region. Costs stay exact either way. A
+       Node of the same state as node is dealt with as by Insert().
+
+       \param[in] node The Node to insert. Its hash_ must be keyed on the
+                  region (Node::KeyOnRegion()), as must that of every other
+                  Node in the table.
+       \param[in] region The tiles the player of node can walk to without
+                  changing the state; see player_region().
+       \param[in] bb The bitboards of the level.
+       \param[out] previous Set to the replaced Node if the result is IMPROVED.
+       \returns What was done with node, as for Insert().
+     */
+    InsertResult InsertInRegion(Node* node, const Bitboard& region,
+                                const LevelBitboards& bb, Node** previous);
+
+    /**
+       \brief Move node from the open set to the closed set.
+       \returns false if node is not the open Node for its state.
+     */
+    bool Close(const Node* node);
+
+    /**
+       \brief Remove node from the open set, as if its state had never been
+              seen. The Node is not deleted.
+       \returns false if node is not the open Node for its state.
+     */
+    bool Erase(const Node* node);
+
+    /**
+       \brief Move a closed state back to the open set if node reaches it with
+              a better gscore. The closed Node is not deleted; it may still be
+              the predecessor of other Nodes.
+       \returns true if node replaced the closed Node.
+     */
+    bool Reopen(Node* node);
+
+    /** Remove every entry without deleting the Nodes. */
+    void Clear();
+
+    /** \returns The Node with the same state as node, or NULL. */
+    Node* Find(const Node& node) const;
+
+    /** \returns true if the state of node is in the closed set. */
+    bool IsClosed(const Node& node) const;
+
+    size_t open_size() const { return open_size_; }
+    size_t closed_size() const { return closed_size_; }
+    size_t size() const { return open_size_ + closed_size_; }
+    size_t capacity() const { return capacity_; }
+
+    /**
+       \returns The number of Nodes that InsertInRegion() dropped or replaced
+                because of a Node whose player stands elsewhere in the region.
+     */
+    size_t merged() const { return merged_; }
+
+    /** \returns Bytes used by the table itself (not the Nodes). */
+    size_t memory_usage() const { return capacity_ * sizeof(Entry); }
+
+private:
+    // The low bit of key is the closed flag; the other 63 bits are the upper
+    // bits of the Node hash. An entry with node == NULL is empty.
+    struct Entry
+    {
+        Node* node;
+        uint64_t key;
+    };
+
+    static const uint64_t kClosedBit = 1;
+
+    static uint64_t MakeKey(uint64_t hash) { return hash & ~kClosedBit; }
+
+    size_t FindSlot(const Node& node) const;
+    void InsertAt(size_t i, Node* node);
+    void Grow();
+    Entry* NewEntries(size_t capacity);
+    void DeleteEntries(Entry* entries, size_t capacity);
+
+    Arena* arena_;
+    Entry* entries_;
+    size_t capacity_; // always a power of 2
+    size_t mask_;
+    size_t open_size_;
+    size_t closed_size_;
+    size_t merged_;
+
+    TranspositionTable(const TranspositionTable& other); // no copy
+    TranspositionTable& operator=(const TranspositionTable& other); // no copy
+};
+
+} // namespace boxedin
+
+#endif
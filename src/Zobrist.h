@@ -0,0 +1,63 @@
+/**
+ * \file Zobrist.h
+ * \brief Zobrist-style hash keys for Boxed In search states.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ */
+#ifndef ZOBRIST_H__
+#define ZOBRIST_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace boxedin
+{
+
+// A state hash is the XOR of one key per state element: the player tile, each
+// box tile and each gear that has not been picked up. Moving the player or a
+// box, or picking up a gear, updates the hash with two (or one) XORs, so a
+// successor Node's hash is derived from its predecessor's hash in O(1).
+//
+// Keys are not stored in a table; each key is a splitmix64 mix of the element
+// kind and index. This keeps hashing free of any per-level or global state.
+
+enum ZobristKind
+{
+    ZOBRIST_PLAYER = 0,
+    ZOBRIST_BOX,
+    ZOBRIST_GEAR,
+    ZOBRIST_KINDS
+};
+
+inline uint64_t zobrist_mix(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+inline uint64_t zobrist_key(ZobristKind kind, size_t index)
+{
+    return zobrist_mix((uint64_t)index * ZOBRIST_KINDS + kind);
+}
+
+inline uint64_t zobrist_player(size_t tile_index)
+{
+    return zobrist_key(ZOBRIST_PLAYER, tile_index);
+}
+
+inline uint64_t zobrist_box(size_t tile_index)
+{
+    return zobrist_key(ZOBRIST_BOX, tile_index);
+}
+
+inline uint64_t zobrist_gear(size_t gear_index)
+{
+    return zobrist_key(ZOBRIST_GEAR, gear_index);
+}
+
+} // namespace boxedin
+
+#endif
@@ -0,0 +1,373 @@
+/**
+ * \file arastar.cc
+ * \brief Weighted A* and anytime repairing A* (ARA*) implementation of Boxed In
+ *        Level-Solver.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ */
+
+#include <math.h>
+
+#include <chrono>
+#include <list>
+#include <vector>
+
+#include "arastar.h"
+#include "astar.h"
+#include "config.h"
+#include "BucketQueue.h"
+#include "Node.h"
+#include "TranspositionTable.h"
+
+using namespace std;
+using namespace std::chrono;
+
+namespace boxedin {
+
+namespace {
+
+// Each ARA* iteration lowers the weight by at least this much
+#define ARASTAR_WEIGHT_STEP 0.5
+
+// The deadline is checked after every this many expansions
+#define ARASTAR_DEADLINE_CHECK_INTERVAL 256
+
+
+/**
+   \class AraSearch
+   \brief State of a weighted A* search that can be continued with a lower
+          weight.
+
+   This follows ARA* (Likhachev, Gordon and Thrun). Within one iteration a
+   closed state is never expanded again; if it is reached with a better
+   gscore, the new Node is kept in inconsistent_ and moved to the open set
+   when the next iteration starts.
+ */
+class AraSearch
+{
+public:
+    AraSearch(const Level& level, Heuristic& heuristic, double weight,
+              double deadline_seconds)
+        : pool_(sizeof(Node), arena_)
+        , level_(level)
+        , heuristic_(heuristic)
+        , weight_(weight)
+        , open_(MaxPriority(weight), BucketQueue::TIE_BREAK_LOW_H_LIFO, &arena_)
+        , table_(1 << 16, &arena_)
+        , incumbent_(NULL)
+        , expanded_(0)
+        , has_deadline_(deadline_seconds > 0)
+    {
+        deadline_ = steady_clock::now() +
+            duration_cast<steady_clock::duration>(duration<double>(deadline_seconds));
+    }
+
+    void Start(Node* start)
+    {
+        table_.Insert(start, NULL);
+        if (start->fscore() < MAX_FSCORE)
+        {
+            open_.Push(start, Priority(*start));
+        }
+    }
+
+    /**
+       \brief Expand Nodes in order of g + W*h until no Node in the open set
+              could lead to a solution better than the incumbent.
+       \returns false if the deadline passed first.
+     */
+    bool ImprovePath()
+    {
+        while (open_.MinPriority() < IncumbentCost())
+        {
+            Node* node = open_.Pop();
+            if (node->fscore() >= IncumbentCost())
+            {
+                // Can no longer lead to a better solution; the table still
+                // points to it so it is not deleted.
+                continue;
+            }
+
+            table_.Close(node);
+
+            if (node->IsGoal(level_))
+            {
+                incumbent_ = node;
+                continue;
+            }
+
+            expanded_++;
+            if (has_deadline_ &&
+                (expanded_ % ARASTAR_DEADLINE_CHECK_INTERVAL) == 0 &&
+                steady_clock::now() >= deadline_)
+            {
+                return false;
+            }
+
+            list<Node*> successors = generate_successors(level_, heuristic_, *node, &pruned_);
+            for (list<Node*>::iterator it = successors.begin(); it != successors.end(); ++it)
+            {
+                Node* successor = *it;
+                if (successor->hscore_ >= MAX_FSCORE ||
+                    successor->fscore() >= IncumbentCost())
+                {
+                    delete successor;
+                    continue;
+                }
+
+                Node* previous = NULL;
+                switch (table_.Insert(successor, &previous))
+                {
+                case TranspositionTable::INSERTED:
+                    open_.Push(successor, Priority(*successor));
+                    break;
+                case TranspositionTable::IMPROVED:
+                    Discard(open_, previous);
+                    open_.Push(successor, Priority(*successor));
+                    break;
+                case TranspositionTable::DUPLICATE_OPEN:
+                    delete successor;
+                    break;
+                case TranspositionTable::DUPLICATE_CLOSED:
+                    if (successor->gscore_ < table_.Find(*successor)->gscore_)
+                    {
+                        inconsistent_.push_back(successor);
+                    }
+                    else
+                    {
+                        delete successor;
+                    }
+                    break;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+       \brief Lower the weight and move the inconsistent Nodes to the open set
+              for the next iteration.
+     */
+    void SetWeight(double weight)
+    {
+        weight_ = weight;
+
+        BucketQueue open(MaxPriority(weight_), BucketQueue::TIE_BREAK_LOW_H_LIFO, &arena_);
+        Node* node = NULL;
+        while ((node = open_.Pop()) != NULL)
+        {
+            if (node->fscore() < IncumbentCost())
+            {
+                open.Push(node, Priority(*node));
+            }
+        }
+
+        for (size_t i = 0; i < inconsistent_.size(); i++)
+        {
+            node = inconsistent_[i];
+            if (node->fscore() >= IncumbentCost())
+            {
+                delete node;
+                continue;
+            }
+            if (table_.Reopen(node))
+            {
+                open.Push(node, Priority(*node));
+                continue;
+            }
+            // The state was already reopened by another inconsistent Node
+            Node* previous = NULL;
+            switch (table_.Insert(node, &previous))
+            {
+            case TranspositionTable::IMPROVED:
+                Discard(open, previous);
+                open.Push(node, Priority(*node));
+                break;
+            default:
+                delete node;
+                break;
+            }
+        }
+        inconsistent_.clear();
+
+        open_.swap(open);
+    }
+
+    /**
+       \returns A proven bound on incumbent cost / optimal cost.
+       \details Every state on an optimal path that has not been expanded with
+                its optimal gscore is either in the open set, in
+                inconsistent_, or was pruned because its fscore is no better
+                than the incumbent. So the lowest fscore among them is a lower
+                bound on the optimal cost.
+     */
+    double Bound() const
+    {
+        if (!incumbent_)
+        {
+            return COST_INFINITY;
+        }
+        cost_t lower_bound = IncumbentCost();
+        cost_t lowest_open = open_.LowestFscore();
+        if (lowest_open < lower_bound)
+        {
+            lower_bound = lowest_open;
+        }
+        for (size_t i = 0; i < inconsistent_.size(); i++)
+        {
+            if (inconsistent_[i]->fscore() < lower_bound)
+            {
+                lower_bound = inconsistent_[i]->fscore();
+            }
+        }
+        if (lower_bound <= 0)
+        {
+            return 1.0;
+        }
+        return (double)IncumbentCost() / (double)lower_bound;
+    }
+
+    bool Exhausted() const { return open_.empty() && inconsistent_.empty(); }
+
+    double weight() const { return weight_; }
+    const Node* incumbent() const { return incumbent_; }
+    uint64_t expanded() const { return expanded_; }
+    const PruneCounts& pruned() const { return pruned_; }
+    const TranspositionTable& table() const { return table_; }
+    const Level& level() const { return level_; }
+
+    // Every Node of the search comes from this pool
+    NodePool& pool() { return pool_; }
+
+private:
+    cost_t IncumbentCost() const
+    {
+        return incumbent_ ? incumbent_->gscore_ : MAX_FSCORE;
+    }
+
+    cost_t Priority(const Node& node) const
+    {
+        return node.gscore_ + (cost_t)floor(weight_ * node.hscore_);
+    }
+
+    // Delete an open Node whose state was reached with a better gscore. It
+    // has not been expanded, so no other Node points to it. It is not in the
+    // queue if it was pruned by the incumbent.
+    void Discard(BucketQueue& open, Node* node)
+    {
+        if (BucketQueue::IsQueued(node))
+        {
+            open.Remove(node, Priority(*node));
+        }
+        delete node;
+    }
+
+    // Nodes with fscore >= MAX_FSCORE are pruned, so g + W*h < W*MAX_FSCORE.
+    static cost_t MaxPriority(double weight)
+    {
+        return (cost_t)ceil(weight * MAX_FSCORE) + 1;
+    }
+
+    // Declared first so the Nodes outlive the containers that point to them
+    Arena arena_;
+    NodePool pool_;
+    const Level& level_;
+    Heuristic& heuristic_;
+    double weight_;
+    BucketQueue open_;
+    TranspositionTable table_;
+    vector<Node*> inconsistent_;
+    Node* incumbent_;
+    uint64_t expanded_;
+    PruneCounts pruned_;
+    bool has_deadline_;
+    steady_clock::time_point deadline_;
+};
+
+
+void set_result(const AraSearch& search, SearchResult& result)
+{
+    result.nodes_expanded = search.expanded();
+    result.pruned = search.pruned();
+    if (search.incumbent())
+    {
+        result.suboptimality_bound = search.Bound();
+        result.SetSucceeded(search.level(), search.incumbent(), search.table().open_size(),
+                            search.table().closed_size());
+    }
+    else
+    {
+        result.SetFailed(search.table().open_size(), search.table().closed_size());
+    }
+}
+
+} // anonymous namespace
+
+
+SearchResult weighted_astar(Level& level, Heuristic& heuristic, double weight)
+{
+    SearchResult result;
+    AraSearch search(level, heuristic, weight, 0);
+    ScopedNodePool scope(&search.pool());
+    search.Start(Node::MakeStartNode(level, heuristic));
+    search.ImprovePath();
+    set_result(search, result);
+    return result;
+}
+
+
+SearchResult arastar(Level& level, Heuristic& heuristic, double weight,
+                     double deadline_seconds)
+{
+    SearchResult result;
+    AraSearch search(level, heuristic, weight, deadline_seconds);
+    ScopedNodePool scope(&search.pool());
+    search.Start(Node::MakeStartNode(level, heuristic));
+
+    const Node* reported = NULL;
+    for (;;)
+    {
+        bool finished = search.ImprovePath();
+
+        if (search.incumbent() && search.incumbent() != reported)
+        {
+            reported = search.incumbent();
+            SearchResult improved;
+            improved.SetSucceeded(level, reported, 0, 0);
+            fprintf(stderr, "ARA* weight %.2f: %d moves, suboptimality bound %.3f, "
+                    "%lu nodes expanded\n%s\n", search.weight(), improved.num_moves,
+                    search.Bound(), (unsigned long)search.expanded(),
+                    improved.solution.c_str());
+        }
+
+        if (!finished)
+        {
+            fprintf(stderr, "ARA* deadline reached\n");
+            break;
+        }
+
+        double bound = search.Bound();
+        if (bound <= 1.0 || search.Exhausted())
+        {
+            break;
+        }
+
+        // There is no point searching with a weight above the proven bound
+        double next_weight = search.weight() - ARASTAR_WEIGHT_STEP;
+        if (bound < next_weight)
+        {
+            next_weight = bound;
+        }
+        if (next_weight < 1.0)
+        {
+            next_weight = 1.0;
+        }
+        search.SetWeight(next_weight);
+    }
+
+    set_result(search, result);
+    return result;
+}
+
+} // namespace boxedin
@@ -0,0 +1,49 @@
+/**
+ * \file arastar.h
+ * \brief Weighted A* and anytime repairing A* (ARA*) implementation of Boxed In
+ *        Level-Solver.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ */
+#ifndef ARASTAR_H__
+#define ARASTAR_H__
+
+#include "boxedintypes.h"
+#include "SearchResult.h"
+#include "Level.h"
+#include "Heuristic.h"
+
+namespace boxedin {
+
+/**
+   \brief Weighted A* search; Nodes are expanded in order of g + W*h.
+   \details The solution is found faster than with A* but may be longer than
+            optimal. SearchResult::suboptimality_bound is set to a proven
+            bound on how much longer: the solution length divided by the
+            lowest fscore among the states that were not fully evaluated.
+   \param[in] level The level to solve.
+   \param[in] heuristic An admissible heuristic.
+   \param[in] weight Heuristic weight W >= 1.
+ */
+SearchResult weighted_astar(Level& level, Heuristic& heuristic, double weight);
+
+/**
+   \brief Anytime repairing A* (ARA*).
+   \details Runs weighted A* with weight, then repeatedly lowers the weight
+            and continues the same search, reusing every state evaluated so
+            far. Each improved solution is reported on stderr along with its
+            proven suboptimality bound. The search stops when the solution is
+            proven optimal or when the deadline passes.
+   \param[in] level The level to solve.
+   \param[in] heuristic An admissible heuristic.
+   \param[in] weight Initial heuristic weight W >= 1.
+   \param[in] deadline_seconds Wall-clock time limit; 0 for no limit.
+   \returns The best solution found.
+ */
+SearchResult arastar(Level& level, Heuristic& heuristic, double weight,
+                     double deadline_seconds);
+
+} // namespace
+
+#endif
@@ -7,364 +7,536 @@
  */
 
 #include <iostream>
+#include <stdexcept>
 
 #include "astar.h"
+#include "Bitboard.h"
 #include "boxedinio.h"
 #include "config.h"
 #include "Node.h"
 #include "Level.h"
+#include "BucketQueue.h"
 #include "Heuristic.h"
-#include "FloodFillNode.h"
+#include "SearchContext.h"
+#include "TranspositionTable.h"
 
 using namespace std;
 
 namespace boxedin {
 
 
-// The set of nodes already evaluated
-set<Node*, NodeCompare> closed_set;
+namespace {
 
-// The current set of nodes that are not evaluated yet.
-// Initially, only the start node is known.
-set<Node*, NodeCompare> open_set;
-
-vector<list<Node*> > openset_fscore_nodes;
-
-Node* get_next_best_fscore_node(cost_t current_fscore)
+// Directions in the order that the flood fill extends paths
+const EncodedPathDirection kDirections[4] =
 {
-    Node* node = NULL;
-    cost_t fscore = current_fscore;
-    while ( (node == NULL) && (fscore < MAX_FSCORE) )
+    ENCODED_PATH_DIRECTION_UP,
+    ENCODED_PATH_DIRECTION_DOWN,
+    ENCODED_PATH_DIRECTION_LEFT,
+    ENCODED_PATH_DIRECTION_RIGHT
+};
+
+// Path from the player to tile along the parent links of the flood fill
+EncodedPath make_path(int tile, int start, const tile_index_t* parent, const uint8_t* direction)
+{
+    uint8_t steps[BITBOARD_TILES];
+    int n = 0;
+    for (int t = tile; t != start; t = parent[t])
     {
-        list<Node*>& nodes = openset_fscore_nodes[fscore];
-        if ( nodes.empty() )
-        {
-#if 0
-            fprintf(stderr, "empty node list at index %d\n", (int)fscore);
-#endif
-            fscore++;
-            continue;
-        }
-        node = nodes.front();
-        nodes.pop_front();
+        steps[n++] = direction[t];
+    }
+    EncodedPath path;
+    while (n > 0)
+    {
+        path.push_back(kDirections[steps[--n]]);
     }
-    return node;
+    return path;
 }
 
-
-list<Action> find_actions(const Level& level, const Node& node)
+// The reachable tiles are found with a flood fill that steps all of its
+// frontier at once. The action tiles are then known, so the breadth first
+// search that follows stops as soon as it has reached them all. It visits
+// tiles in the same order, and finds the same paths, as a flood fill of
+// Level::MakeFloodFillMap() that extends paths up, down, left, right.
+// The path of each action is only built if paths is not NULL.
+void flood_actions(const Level& level, const Node& node, ActionVector& actions,
+                   vector<EncodedPath>* paths)
 {
-    list<Action> actions;
-    uint8_t floor_width = (uint8_t)level.floor_plan_[0].size();
-    uint8_t floor_height = (uint8_t)level.floor_plan_.size();
-    bool draw_player = false;
-    vector<vector<char> > charmap = level.MakeFloodFillMap( node, draw_player );
-#if 0
-    fprintf(stderr, "finding actions for:\n");
-    PrintCharMapInColor(cerr, charmap);
-#endif
-    //// Flood fill to find all action points ////
-
-    // Queue of spaces to fill is initially the current player position
-    queue<FloodFillNode> flood_fill_queue;
-    flood_fill_queue.push( FloodFillNode(node.player_coord_) );
-
-    bool is_player_on_switch = is_switch(charmap, node.player_coord_.x, node.player_coord_.y);
-    
-    while ( !flood_fill_queue.empty() )
+    actions.clear();
+    if (paths)
     {
-        FloodFillNode ffnode = flood_fill_queue.front();
-        Coord& coord = ffnode.coord;
-#if 0
-        fprintf(stderr, "flood fill map:\n");
-        PrintCharMapInColor(cerr, charmap);
-#endif
-        // If player is on a switch, stepping off of the switch is an "action".
-        // Step off the switch in any possible directions and do not continue
-        // the flood fill algorithm.
-        if (is_player_on_switch)
+        paths->clear();
+    }
+    const LevelBitboards& bb = level.bitboards_;
+    StateBitboards state(bb, node);
+    int start = bb.TileIndex(node.player_coord_);
+    Bitboard start_tile = Bitboard::Tile(start);
+    const int offsets[4] = { -bb.width, bb.width, -1, 1 };
+
+    // Tiles next to a box that can be pushed up, down, left, right
+    Bitboard pushes[4];
+    pushes[0] = bb.Down(state.boxes & bb.Down(state.holdable));
+    pushes[1] = bb.Up(state.boxes & bb.Up(state.holdable));
+    pushes[2] = bb.Right(state.boxes & bb.Right(state.holdable));
+    pushes[3] = bb.Left(state.boxes & bb.Left(state.holdable));
+
+    // If player is on a switch, stepping off of the switch is an "action".
+    // Step off the switch in any possible directions and do not continue
+    // the flood fill algorithm.
+    if (state.switches.Test(start))
+    {
+        Bitboard steps[4] = { bb.Up(start_tile), bb.Down(start_tile),
+                              bb.Left(start_tile), bb.Right(start_tile) };
+        for (int d = 0; d < 4; d++)
         {
-            // is the tile above walkable?
-            if (Level::CanMoveUp(charmap, coord.x, coord.y))
+            if ((steps[d] & state.walkable).Any() || pushes[d].Test(start))
             {
-                Action action( ffnode.path, ffnode.coord );
-                action.path.push_back( ENCODED_PATH_DIRECTION_UP );
-                action.point.y--;
-                actions.push_back( action  );            
-            }
-            // is the tile below walkable?
-            if (Level::CanMoveDown(charmap, coord.x, coord.y))
-            {
-                Action action( ffnode.path, ffnode.coord );
-                action.path.push_back( ENCODED_PATH_DIRECTION_DOWN );
-                action.point.y++;
-                actions.push_back( action  );            
-            }
-            // is the tile left walkable?
-            if (Level::CanMoveLeft(charmap, coord.x, coord.y))
-            {
-                Action action( ffnode.path, ffnode.coord );
-                action.path.push_back( ENCODED_PATH_DIRECTION_LEFT );
-                action.point.x--;
-                actions.push_back( action  );            
-            }
-            // is the tile right walkable?
-            if (Level::CanMoveRight(charmap, coord.x, coord.y))
-            {
-                Action action( ffnode.path, ffnode.coord );
-                action.path.push_back( ENCODED_PATH_DIRECTION_RIGHT );
-                action.point.x++;
-                actions.push_back( action  );            
+                actions.push_back( ActionPoint(bb.TileCoord(start + offsets[d]), kDirections[d], 1) );
+                if (paths)
+                {
+                    EncodedPath path;
+                    path.push_back(kDirections[d]);
+                    paths->push_back(path);
+                }
             }
-            break; // break out of loop
         }
+        return;
+    }
 
-        // Skip node if it's position has been filled
-        if (charmap[coord.y][coord.x] == '-')
-        {
-            flood_fill_queue.pop();
-            continue;
-        }
+    // Tiles the player can reach
+    Bitboard reached = start_tile;
+    Bitboard frontier = start_tile & state.floodable;
+    while (frontier.Any())
+    {
+        frontier = bb.Neighbors(frontier).AndNot(reached) & state.walkable;
+        reached |= frontier;
+        frontier &= state.floodable;
+    }
 
-        // If it's an action point, add it to the results
+    // Tiles that produce actions
+    Bitboard targets = reached & state.targets;
+    Bitboard pushers = reached.AndNot(state.targets) & (pushes[0] | pushes[1] | pushes[2] | pushes[3]);
+    int pending = (targets | pushers).Count();
+    if (pending == 0)
+    {
+        return;
+    }
 
-        if ( charmap[coord.y][coord.x] == '@' ) // exit
-        {
-            actions.push_back( Action(ffnode.path, ffnode.coord) );            
-        }
-        else if ( charmap[coord.y][coord.x] == '*' ) // gear
-        {
-            actions.push_back( Action(ffnode.path, ffnode.coord) );            
-        }
-        else if ( is_switch(charmap, coord.x, coord.y) ) // switch
-        {
-            actions.push_back( Action(ffnode.path, ffnode.coord) );            
-        }
-        else
+    // Breadth first search for the paths, in the same order as before
+    Bitboard has_neighbor[4] = { bb.Down(bb.board), bb.Up(bb.board),
+                                 bb.not_left_column, bb.not_right_column };
+    tile_index_t queue[BITBOARD_TILES];
+    tile_index_t parent[BITBOARD_TILES];
+    uint8_t direction[BITBOARD_TILES];
+    tile_index_t distance[BITBOARD_TILES];
+    Bitboard queued = start_tile;
+    distance[start] = 0;
+    direction[start] = 0;
+    int head = 0;
+    int tail = 0;
+    queue[tail++] = (tile_index_t)start;
+    while (pending > 0)
+    {
+        int tile = queue[head++];
+        if (targets.Test(tile))
         {
-            // is there a box directly above that can be pushed?
-            if ( Level::IsBoxAndCanMoveUp(charmap, coord.x, coord.y-1))
-            {
-                Action action( ffnode.path, ffnode.coord );
-                action.path.push_back( ENCODED_PATH_DIRECTION_UP );
-                action.point.y--;
-                actions.push_back( action  );            
-            }
-            // is there a box directly below that can be pushed?
-            if (Level::IsBoxAndCanMoveDown(charmap, coord.x, coord.y+1))
+            actions.push_back( ActionPoint(bb.TileCoord(tile), kDirections[direction[tile]],
+                                           distance[tile]) );
+            if (paths)
             {
-                Action action( ffnode.path, ffnode.coord );
-                action.path.push_back( ENCODED_PATH_DIRECTION_DOWN );
-                action.point.y++;
-                actions.push_back( action  );            
+                paths->push_back(make_path(tile, start, parent, direction));
             }
-            // is there a box directly left that can be pushed?
-            if (Level::IsBoxAndCanMoveLeft(charmap, coord.x-1, coord.y))
-            {
-                Action action( ffnode.path, ffnode.coord );
-                action.path.push_back( ENCODED_PATH_DIRECTION_LEFT );
-                action.point.x--;
-                actions.push_back( action  );            
-            }
-            // is there a box directly right that can be pushed?
-            if (Level::IsBoxAndCanMoveRight(charmap, coord.x+1, coord.y))
+            pending--;
+        }
+        else if (pushers.Test(tile))
+        {
+            for (int d = 0; d < 4; d++)
             {
-                Action action( ffnode.path, ffnode.coord );
-                action.path.push_back( ENCODED_PATH_DIRECTION_RIGHT );
-                action.point.x++;
-                actions.push_back( action  );            
+                if (pushes[d].Test(tile))
+                {
+                    actions.push_back( ActionPoint(bb.TileCoord(tile + offsets[d]), kDirections[d],
+                                                   distance[tile] + 1) );
+                    if (paths)
+                    {
+                        EncodedPath path = make_path(tile, start, parent, direction);
+                        path.push_back(kDirections[d]);
+                        paths->push_back(path);
+                    }
+                }
             }
+            pending--;
         }
 
-        if ( can_flood(charmap, coord.x, coord.y) )
+        if (state.floodable.Test(tile))
         {
-            //// Add neighbor nodes in the 4 directions ////
-            
-            // UP
-            if ( (coord.y > 0) && is_walkable(charmap, coord.x, coord.y-1) )
+            for (int d = 0; d < 4; d++)
             {
-                FloodFillNode up( ffnode ); // copy of node
-                up.path.push_back( ENCODED_PATH_DIRECTION_UP );
-                up.coord.y--;
-                flood_fill_queue.push( up );
-            }
-            // DOWN
-            if ( (coord.y < floor_height-1) && is_walkable(charmap, coord.x, coord.y+1) )
-            {
-                FloodFillNode down( ffnode ); // copy of node
-                down.path.push_back( ENCODED_PATH_DIRECTION_DOWN );
-                down.coord.y++;
-                flood_fill_queue.push( down );
-            }
-            // LEFT
-            if ( (coord.x > 0) && is_walkable(charmap, coord.x-1, coord.y) )
-            {
-                FloodFillNode left( ffnode ); // copy of node
-                left.path.push_back( ENCODED_PATH_DIRECTION_LEFT );
-                left.coord.x--;
-                flood_fill_queue.push( left );
-            }
-            // RIGHT
-            if ( (coord.x < floor_width-1) && is_walkable(charmap, coord.x+1, coord.y) )
-            {
-                FloodFillNode right( ffnode ); // copy of node
-                right.path.push_back( ENCODED_PATH_DIRECTION_RIGHT );
-                right.coord.x++;
-                flood_fill_queue.push( right );
+                int next = tile + offsets[d];
+                if (has_neighbor[d].Test(tile) && reached.Test(next) && !queued.Test(next))
+                {
+                    queued.Set(next);
+                    parent[next] = (tile_index_t)tile;
+                    direction[next] = (uint8_t)d;
+                    distance[next] = (tile_index_t)(distance[tile] + 1);
+                    queue[tail++] = (tile_index_t)next;
+                }
             }
         }
+    }
+}
 
-        // Mark current point as filled
-        charmap[coord.y][coord.x] = '-';
+} // anonymous namespace
 
-    } // end while
-    
+
+list<Action> find_actions(const Level& level, const Node& node)
+{
+    ActionVector points;
+    vector<EncodedPath> paths;
+    flood_actions(level, node, points, &paths);
+    list<Action> actions;
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        actions.push_back( Action(paths[i], points[i].point) );
+    }
     return actions;
 }
 
-int is_boxing_char(char c)
+void find_actions(const Level& level, const Node& node, ActionVector& actions)
+{
+    flood_actions(level, node, actions, NULL);
+}
+
+Bitboard player_region(const Level& level, const Node& node)
 {
-    switch (c)
+    const LevelBitboards& bb = level.bitboards_;
+    StateBitboards state(bb, node);
+    Bitboard reached = Bitboard::Tile(bb.TileIndex(node.player_coord_));
+    Bitboard frontier = reached & state.floodable;
+    while (frontier.Any())
     {
-    case '\'':
-    case 'x':
-    case '+':
-        return 1;
-    default:
-        return 0;
+        frontier = bb.Neighbors(frontier).AndNot(reached) & state.floodable;
+        reached |= frontier;
     }
+    return reached;
 }
 
-// TODO: documentation
-bool boxed_in(const Coord& coord, vector<vector<char> >& charmap)
+EncodedPath find_path(const Level& level, const Node& node, const Node& successor)
 {
-    uint8_t x = coord.x;
-    uint8_t y = coord.y;
-    uint8_t floor_width = (uint8_t)charmap[0].size();
-    uint8_t floor_height = (uint8_t)charmap.size();
-    
-    int nw = (x > 0 && y > 0) ? is_boxing_char(charmap[y-1][x-1]) : 0;
-    int n = (y > 0) ? is_boxing_char(charmap[y-1][x]) : 0;
-    int ne = (x < floor_width-1 && y > 0) ? is_boxing_char(charmap[y-1][x+1]) : 0;
-    int e = (x < floor_width-1) ? is_boxing_char(charmap[y][x+1]) : 0;
-    int se = (x < floor_width-1 && y < floor_height-1) ? is_boxing_char(charmap[y+1][x+1]) : 0;
-    int s = (y < floor_height-1) ? is_boxing_char(charmap[y+1][x]) : 0;
-    int sw = (x > 0 && y < floor_height-1) ? is_boxing_char(charmap[y+1][x-1]) : 0;
-    int w = (x > 0) ? is_boxing_char(charmap[y][x-1]) : 0;
-#if 0
-    fprintf(stderr, "-----------\n");
-    fprintf(stderr, "  %d%d%d\n", nw, n, ne);
-    fprintf(stderr, "  %d %d\n", w, e);
-    fprintf(stderr, "  %d%d%d\n", sw, s, se);
-#endif
-    if ( (n + s + e + w == 4) &&
-         (nw + ne + se + sw >= 3) )
+    ActionVector points;
+    vector<EncodedPath> paths;
+    flood_actions(level, node, points, &paths);
+    for (size_t i = 0; i < points.size(); i++)
     {
-        return true; // char c is boxed in!
+        if (points[i].point == successor.player_coord_ &&
+            points[i].direction == successor.direction_)
+        {
+            return paths[i];
+        }
     }
-    return false;
+
+    // The successor may have pushed a box on through a tunnel
+    Node parent(node);
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        if (points[i].direction != successor.direction_)
+        {
+            continue;
+        }
+        Node pushed(level, parent, points[i]);
+        EncodedPath path = paths[i];
+        while (!SameState(pushed, successor) && pushed.gscore_ < successor.gscore_)
+        {
+            pushed.PushAgain(level);
+            path.push_back((EncodedPathDirection)successor.direction_);
+        }
+        if (SameState(pushed, successor))
+        {
+            return path;
+        }
+    }
+    throw runtime_error("cannot rebuild the path between two Nodes");
 }
 
-bool is_unsolvable(const Level& level, Node& node, vector<vector<char> >& charmap)
+// The exit, or a gear that is left, is boxed in if spaces, walls and boxes
+// are on all 4 sides of it and on at least 3 of its corners. Every tile is
+// tested at once.
+bool is_unsolvable(const Level& level, const Node& node)
 {
-    if ( boxed_in(level.exit_coord_, charmap) )
+    const LevelBitboards& bb = level.bitboards_;
+    Bitboard boxes(node.box_descriptor_.bitfields);
+
+    // A closed gate hides a box under it. The player presses a switch here.
+    Bitboard pressed = boxes | Bitboard::Tile(bb.TileIndex(node.player_coord_));
+    Bitboard gates;
+    for (size_t i = 0; i < bb.switches.size(); i++)
+    {
+        if (!(bb.switches[i] & pressed).Any())
+        {
+            gates |= bb.gates[i];
+        }
+    }
+    Bitboard boxing = bb.boxing | boxes.AndNot(gates);
+
+    // Beyond the edge of a trimmed level is space, which boxes in like a wall
+    Bitboard n = bb.Down(boxing) | bb.edge[0]; // tiles with boxing above
+    Bitboard s = bb.Up(boxing) | bb.edge[1];
+    Bitboard w = bb.Right(boxing) | bb.edge[2];
+    Bitboard e = bb.Left(boxing) | bb.edge[3];
+    Bitboard nw = bb.Right(n) | bb.edge[2];
+    Bitboard ne = bb.Left(n) | bb.edge[3];
+    Bitboard sw = bb.Right(s) | bb.edge[2];
+    Bitboard se = bb.Left(s) | bb.edge[3];
+    Bitboard corners = (nw & ne & (sw | se)) | (sw & se & (nw | ne));
+    Bitboard boxed_in = n & s & e & w & corners;
+
+    Bitboard points = bb.exit;
+    for (size_t i = 0; i < bb.gears.size(); i++)
     {
-        return true;
+        if (node.gear_descriptor_.bitfield & ((gears_bitfield_t)1 << i))
+        {
+            points |= bb.gears[i];
+        }
     }
+    return (boxed_in & points).Any();
+}
 
-    int sz = (int)level.gear_coords_.size();
-    for (int i = 0; i < sz; i++)
+bool is_dead_push(const Level& level, const Node& node, const ActionPoint& action)
+{
+    const LevelBitboards& bb = level.bitboards_;
+    int box = bb.TileIndex(action.point);
+    if (!((node.box_descriptor_.bitfields[box >> 6] >> (box & 63)) & 1))
     {
-        uint16_t bitmask = (uint16_t)1 << i;
-        if ( ((bitmask & node.gear_descriptor_.bitfield) == bitmask) )
+        return false;
+    }
+    // Where the box lands, in the order of EncodedPathDirection
+    const int offsets[4] = { -bb.width, 1, bb.width, -1 };
+    int tile = box + offsets[action.direction];
+    return bb.cuts_exit[action.direction].Test(tile) ||
+           (bb.cut_gears[tile * 4 + action.direction] & node.gear_descriptor_.bitfield);
+}
+
+bool push_through_tunnel(const Level& level, Node& node, PruneCounts* pruned)
+{
+    const LevelBitboards& bb = level.bitboards_;
+    const int dx[4] = { 0, 1, 0, -1 };
+    const int dy[4] = { -1, 0, 1, 0 };
+    const int height = bb.tiles / bb.width;
+    const int d = node.direction_;
+    for (;;)
+    {
+        Coord box(node.player_coord_.x + dx[d], node.player_coord_.y + dy[d]);
+        Coord ahead(box.x + dx[d], box.y + dy[d]);
+        if (box.x >= bb.width || box.y >= height)
         {
-            if ( boxed_in(level.gear_coords_[i], charmap) )
-            {
-                return true;
-            }
+            return true; // off the level; Coord wraps below 0
+        }
+        int tile = bb.TileIndex(box);
+        if (!bb.tunnel[d].Test(tile))
+        {
+            return true;
+        }
+        Bitboard boxes(node.box_descriptor_.bitfields);
+        if (!boxes.Test(tile) || (boxes & bb.tunnel_behind[tile * 4 + d]).Any())
+        {
+            return true;
+        }
+
+        // All the player can do is push the box on
+        if (ahead.x >= bb.width || ahead.y >= height)
+        {
+            return false;
+        }
+        int to = bb.TileIndex(ahead);
+        bool holdable = bb.floor.Test(to) && !boxes.Test(to) && !bb.exit.Test(to);
+        for (size_t i = 0; i < bb.gears.size() && holdable; i++)
+        {
+            holdable = !(bb.gears[i].Test(to) &&
+                         (node.gear_descriptor_.bitfield & ((gears_bitfield_t)1 << i)));
+        }
+        for (size_t i = 0; i < bb.gates.size() && holdable; i++)
+        {
+            holdable = !(bb.gates[i].Test(to) && !(bb.switches[i] & boxes).Any());
+        }
+        if (!holdable ||
+            is_dead_push(level, node, ActionPoint(box, (EncodedPathDirection)d, 1)))
+        {
+            return false;
+        }
+        node.PushAgain(level);
+        if (pruned)
+        {
+            pruned->tunnel_states++;
         }
     }
-    return false;
 }
 
-list<Node*> generate_successors(const Level& level, Heuristic& heuristic, Node& node)
+list<Node*> generate_successors(const Level& level, Heuristic& heuristic, Node& node,
+                                PruneCounts* pruned, DeadlockPatterns* patterns)
 {
-    list<Node*> successors;
-    list<Action> actions = find_actions( level, node );
+    ActionVector actions;
+    NodeVector successors;
+    generate_successors(level, heuristic, node, actions, successors, pruned, patterns);
+    return list<Node*>(successors.begin(), successors.end());
+}
+
+void generate_successors(const Level& level, Heuristic& heuristic, Node& node,
+                         ActionVector& actions, NodeVector& successors,
+                         PruneCounts* pruned, DeadlockPatterns* patterns)
+{
+    successors.clear();
 
 #if 1
-    bool draw_player = true;
-    vector<vector<char> > charmap = level.MakeFloodFillMap( node, draw_player );
-    if ( is_unsolvable(level, node, charmap) )
+    if ( is_unsolvable(level, node) )
     {
 #if 0
         fprintf(stderr, "pruning unsolvable level---------------------------\n");
-        PrintCharMapInColor(cerr, charmap);
+        PrintCharMapInColor(cerr, level.MakeFloodFillMap( node, true ));
 #endif
-        return successors;
+        if (pruned)
+        {
+            pruned->unsolvable++;
+        }
+        actions.clear();
+        return;
     }
 #endif
 
-    list<Action>::iterator it;
+    find_actions( level, node, actions );
+
+    ActionVector::iterator it;
     for (it=actions.begin(); it!=actions.end(); ++it)
     {
-        Node* successor = new Node( level, heuristic, node, *it );
+        if ( is_dead_push(level, node, *it) )
+        {
+            if (pruned)
+            {
+                pruned->dead_pushes++;
+            }
+            continue;
+        }
+        if ( patterns && patterns->IsDeadPush(node, *it) )
+        {
+            if (pruned)
+            {
+                pruned->dead_patterns++;
+            }
+            continue;
+        }
+        Node* successor = new Node( level, node, *it );
+        if ( !push_through_tunnel(level, *successor, pruned) )
+        {
+            delete successor;
+            continue;
+        }
         successors.push_back( successor );
     }
+    if (!successors.empty())
+    {
+        heuristic.set_hscores(&successors[0], successors.size());
+    }
+}
 
-    return successors;
+SearchResult astar(Level& level, Heuristic& heuristic, BucketQueue::TieBreaking tie_breaking,
+                   bool merge_regions)
+{
+    SearchContext context;
+    return astar(context, level, heuristic, tie_breaking, merge_regions);
 }
 
-SearchResult astar(Level& level, Heuristic& heuristic)
+SearchResult astar(SearchContext& context, const Level& level, Heuristic& heuristic,
+                   BucketQueue::TieBreaking tie_breaking, bool merge_regions)
 {
+    // Forget the Nodes of any earlier search
+    context.Reset();
+    ScopedNodePool scope(&context.pool());
+
+    // The set of nodes already evaluated (closed set) and the current set of
+    // nodes that are not evaluated yet (open set). Initially, only the start
+    // node is known.
+    TranspositionTable& transposition_table = context.table();
+
+    // The open set Nodes, indexed by fscore and then hscore.
+    BucketQueue& openset_fscore_nodes = context.open();
+    openset_fscore_nodes.SetTieBreaking(tie_breaking);
+
     SearchResult result;
     Node* start = Node::MakeStartNode(level, heuristic);
-    
-    open_set.insert(start);
-    openset_fscore_nodes.resize(MAX_FSCORE);
+    if (merge_regions)
+    {
+        start->KeyOnRegion(level, player_region(level, *start).First());
+    }
+
+    transposition_table.Insert(start, NULL);
     if (start->fscore() < MAX_FSCORE)
     {
-        openset_fscore_nodes[start->fscore()].push_back(start);
+        openset_fscore_nodes.Push(start);
     }
 
     Node* node = NULL;
     cost_t fscore = start->fscore();
-    uint64_t better_g_score_count = 0;
+    uint64_t expanded = 0;
+    uint64_t layer_expanded = 0; // in the current fscore layer
     
-    while ( (node = get_next_best_fscore_node(fscore)) != NULL )
+    while ( (node = openset_fscore_nodes.Pop()) != NULL )
     {
+        // The successors were queued with the cheap bound of the heuristic
+        cost_t hscore = heuristic.get_expansion_hscore(*node);
+        if (hscore > node->hscore_)
+        {
+            node->set_hscore(hscore);
+            if (node->fscore() < MAX_FSCORE)
+            {
+                openset_fscore_nodes.Push(node);
+            }
+            else
+            {
+                // Dropped as a successor past MAX_FSCORE would be. A
+                // cheaper path to the state may still come in under it.
+                transposition_table.Erase(node);
+                delete node;
+            }
+            continue;
+        }
+
 #if 1 //TODO: use program option to display fscore
         if ( fscore != node->fscore() )
         {
           fprintf(stderr, "fscore is %d: %d + %d\n", node->fscore(), node->gscore_, node->hscore_);
         }
 #endif
-        fscore = node->fscore();
-
-        if (node->better_gscore_found_)
+        if ( fscore != node->fscore() )
         {
-#if 0
-            fprintf(stderr, "dropping a node (better gscore was found)\n");
-#endif
-            delete node;
-            continue;
+            layer_expanded = 0;
         }
+        fscore = node->fscore();
 
         if ( node->IsGoal(level) )
         {
-            result.SetSucceeded( node, open_set.size(), closed_set.size() );
+            result.nodes_expanded = expanded;
+            result.last_layer_expanded = layer_expanded;
+            result.states_merged = transposition_table.merged();
+            result.SetArenaUsage(context.arena());
+            result.SetSucceeded( level, node, transposition_table.open_size(), transposition_table.closed_size() );
             return result;
         }
 
-        open_set.erase(node);
-        closed_set.insert(node);
+        transposition_table.Close(node);
+        expanded++;
+        layer_expanded++;
 
-        list<Node*> successors = generate_successors(level, heuristic, *node);
+        NodeVector& successors = context.successors();
+        generate_successors(level, heuristic, *node, context.actions(), successors,
+                            &result.pruned, context.patterns());
+
+        // The successors inherit the region key of node, with the player
+        // tile of node swapped for theirs; swap it back out
+        int node_tile = level.bitboards_.TileIndex(node->player_coord_);
+        int node_region_tile = merge_regions ? player_region(level, *node).First() : node_tile;
 
 #if 0
         fprintf(stderr, "%lu successors found\n", successors.size());
 #endif
-        for ( list<Node*>::iterator it = successors.begin(); it != successors.end(); ++it )
+        for ( NodeVector::iterator it = successors.begin(); it != successors.end(); ++it )
         {
             Node* successor = *it;
 
@@ -375,88 +547,67 @@ SearchResult astar(Level& level, Heuristic& heuristic)
             PrintCharMapInColor(cerr, charmap);
 #endif
             
-            // successor already in closed set?
-            set<Node*, NodeCompare>::iterator it_closed = closed_set.find(successor);
-            if ( it_closed != closed_set.end() )
+            if ( successor->fscore() >= MAX_FSCORE)
             {
 #if 0
-                fprintf(stderr, "dropping node already in closedset\n");
+                fprintf(stderr, "warning: dropping node with fscore %d (>%d)\n",
+                        successor->fscore(), MAX_FSCORE);
 #endif
                 delete successor;
                 continue;
             }
 
-            // successor already in open set?
-            set<Node*, NodeCompare>::iterator it_open = open_set.find(successor);
-            if ( it_open != open_set.end() )
+            Node* previous = NULL;
+            TranspositionTable::InsertResult inserted;
+            if (merge_regions)
             {
-                if ( successor->gscore_ < (*it_open)->gscore_)
-                {
-                    ++better_g_score_count;
-                    // Instead of removing the old node from the open_set and openset_fscore_nodes,
-                    // just flag it for deletion.
-                    (*it_open)->better_gscore_found_ = true;
-                }
-                else
-                {
-#if 0
-                    fprintf(stderr, "dropping node already in openset\n");
-#endif
-                    delete successor;
-                    continue;
-                }
+                Bitboard region = player_region(level, *successor);
+                successor->SwapHashedPlayerTile(node_region_tile, node_tile);
+                successor->SwapHashedPlayerTile(level.bitboards_.TileIndex(successor->player_coord_),
+                                                region.First());
+                inserted = transposition_table.InsertInRegion(successor, region, level.bitboards_,
+                                                              &previous);
             }
-
-            // new search node!!!
-            if ( successor->fscore() < MAX_FSCORE)
+            else
             {
-#if 0
-                fprintf(stderr, " inserting successor with fscore=%d\n", successor->fscore());
-#endif
-                open_set.insert( successor );
-                openset_fscore_nodes[successor->fscore()].push_back( successor );
+                inserted = transposition_table.Insert(successor, &previous);
             }
-            else
+            switch ( inserted )
             {
+            case TranspositionTable::DUPLICATE_CLOSED:
 #if 0
-                fprintf(stderr, "warning: dropping node with fscore %d (>%d)\n",
-                        successor->fscore(), MAX_FSCORE);
+                fprintf(stderr, "dropping node already in closedset\n");
 #endif
                 delete successor;
                 continue;
-            }            
-        } // end for (successors)
-
-        // housekeeping; once we cross a threshold, delete nodes that aren't needed because
-        // a better gscore was found
-        if (better_g_score_count > 1000000)
-        {
-          fprintf(stderr, "cleaning stale Node's from openset_fscore_nodes\n");
-          better_g_score_count = 0;
-          size_t sz = openset_fscore_nodes.size();
-          for (auto i = 0; i < sz; ++i)
-          {
-            list<Node*>& nodes = openset_fscore_nodes[i];
-            list<Node*>::iterator it = nodes.begin();
-            while (it != nodes.end())
-            {
-              Node* node = *it;
-              if (node->better_gscore_found_)
-              {
-                nodes.erase(it++);
-                delete node;
-              }
-              else
-              {
-                ++it;
-              }
+            case TranspositionTable::DUPLICATE_OPEN:
+#if 0
+                fprintf(stderr, "dropping node already in openset\n");
+#endif
+                delete successor;
+                continue;
+            case TranspositionTable::IMPROVED:
+                // The old Node has not been expanded, so no other Node
+                // points to it
+                openset_fscore_nodes.Remove(previous);
+                delete previous;
+                break;
+            case TranspositionTable::INSERTED:
+                break;
             }
-          }
-        }
+
+            // new search node!!!
+#if 0
+            fprintf(stderr, " inserting successor with fscore=%d\n", successor->fscore());
+#endif
+            openset_fscore_nodes.Push( successor );
+        } // end for (successors)
     } // end while
 
-    //TODO: delete heap memory
-    result.SetFailed(open_set.size(), closed_set.size());
+    result.nodes_expanded = expanded;
+    result.states_merged = transposition_table.merged();
+    result.SetArenaUsage(context.arena());
+    result.SetFailed(transposition_table.open_size(), transposition_table.closed_size());
     return result;
 }
 
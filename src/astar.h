@@ -19,7 +19,11 @@
 
 #include "boxedindefs.h"
 #include "boxedintypes.h"
+#include "Arena.h"
+#include "Bitboard.h"
+#include "DeadlockPatterns.h"
 #include "SearchResult.h"
+#include "BucketQueue.h"
 #include "Node.h"
 #include "Level.h"
 #include "Heuristic.h"
@@ -30,8 +34,125 @@
  */
 namespace boxedin {
 
-SearchResult astar(Level& level, Heuristic& heuristic);
+class SearchContext; // forward
+
+// Successor storage that a search reuses for every expansion
+typedef std::vector<ActionPoint, ArenaAllocator<ActionPoint> > ActionVector;
+typedef std::vector<Node*, ArenaAllocator<Node*> > NodeVector;
+
+// The tiles of a state as the player sees them: the same classes of tiles
+// as the chars of Level::MakeFloodFillMap(node, false).
+struct StateBitboards
+{
+    Bitboard boxes;     // boxes that are not under a closed gate
+    Bitboard walkable;  // floor without a box or a closed gate
+    Bitboard floodable; // walkable and not an action point
+    Bitboard holdable;  // walkable tiles that a box can be pushed onto
+    Bitboard targets;   // exit, gears and switches that are not pressed
+    Bitboard switches;  // switches that are not pressed
+
+    StateBitboards(const LevelBitboards& bb, const Node& node)
+    {
+        Bitboard all_boxes(node.box_descriptor_.bitfields);
+        Bitboard gears;
+        for (size_t i = 0; i < bb.gears.size(); i++)
+        {
+            if (node.gear_descriptor_.bitfield & ((gears_bitfield_t)1 << i))
+            {
+                gears |= bb.gears[i];
+            }
+        }
+        // A switch is pressed by a box; the player is not drawn
+        Bitboard gates;
+        for (size_t i = 0; i < bb.switches.size(); i++)
+        {
+            if (!(bb.switches[i] & all_boxes).Any())
+            {
+                switches |= bb.switches[i];
+                gates |= bb.gates[i];
+            }
+        }
+        Bitboard points = gears | bb.exit | switches;
+        boxes = all_boxes.AndNot(gates);
+        walkable = bb.floor.AndNot(all_boxes | gates);
+        floodable = walkable.AndNot(points);
+        holdable = walkable.AndNot(gears | bb.exit);
+        targets = walkable & points;
+    }
+};
+
+SearchResult astar(Level& level, Heuristic& heuristic,
+                   BucketQueue::TieBreaking tie_breaking = BucketQueue::TIE_BREAK_LOW_H_LIFO,
+                   bool merge_regions = false);
+
+/**
+   \brief A* search that keeps all of its state in context.
+   \details The Nodes of any earlier search in context are freed first. The
+            Nodes of this search stay in context until it is reset or
+            destroyed.
+   \param[in] merge_regions Key states on the region the player can walk in
+              instead of the tile of the player, and drop a state when
+              another one whose player is elsewhere in the region reaches it
+              for no more moves (TranspositionTable::InsertInRegion()).
+              Solutions stay optimal.
+ */
+SearchResult astar(SearchContext& context, const Level& level, Heuristic& heuristic,
+                   BucketQueue::TieBreaking tie_breaking = BucketQueue::TIE_BREAK_LOW_H_LIFO,
+                   bool merge_regions = false);
 std::list<Action> find_actions(const Level& level, const Node& node);
+void find_actions(const Level& level, const Node& node, ActionVector& actions);
+
+/**
+   \returns The tiles the player of node can walk to without stepping on an
+            action point, which would change the state. Only the tile of
+            the player if it is an action point itself (e.g. a switch).
+ */
+Bitboard player_region(const Level& level, const Node& node);
+
+/**
+   \returns true if a box, wall or space boxes in the exit or a gear that is
+            left, so that the player can never reach it.
+ */
+bool is_unsolvable(const Level& level, const Node& node);
+
+/**
+   \returns true if action pushes a box into a choke point where the player
+            can never push it again, and where it walls the player off from
+            the exit or a gear that is left (LevelBitboards::cuts_exit and
+            cut_gears). O(1).
+ */
+bool is_dead_push(const Level& level, const Node& node, const ActionPoint& action);
+
+/**
+   \brief While the player of node is shut in a dead end behind the box in
+          front of it (LevelBitboards::tunnel), push the box on.
+   \details Such a state has one successor, so skipping it keeps solutions
+            optimal. find_path() rebuilds the pushes.
+   \param[in,out] pruned If not NULL, counts the states skipped.
+   \returns false if the box cannot be pushed on, or it would be a dead
+            push, so that node has no successors.
+ */
+bool push_through_tunnel(const Level& level, Node& node, PruneCounts* pruned = NULL);
+
+/**
+   \param[in,out] pruned If not NULL, counts what was pruned.
+   \param[in,out] patterns If not NULL, pushes that leave a dead pattern are
+                  pruned and new patterns are learned.
+ */
+std::list<Node*> generate_successors(const Level& level, Heuristic& heuristic, Node& node,
+                                     PruneCounts* pruned = NULL,
+                                     DeadlockPatterns* patterns = NULL);
+
+/**
+   \brief Replace the contents of successors with the successors of node.
+   \param[in,out] pruned If not NULL, counts what was pruned.
+   \param[in,out] patterns If not NULL, pushes that leave a dead pattern are
+                  pruned and new patterns are learned.
+ */
+void generate_successors(const Level& level, Heuristic& heuristic, Node& node,
+                         ActionVector& actions, NodeVector& successors,
+                         PruneCounts* pruned = NULL,
+                         DeadlockPatterns* patterns = NULL);
 
 } // namespace
 
@@ -32,6 +32,7 @@
 #define EXIT          '@'
 #define PLAYER        'p'
 #define FILLED        '-' // Reserved for Flood Fill algorithm
+#define FILLED_NO_BOX '=' // Reserved for Flood Fill algorithm (gear, exit)
 
 #define IS_FLOOR(c) \
     ( (c == FLOOR) || (c == FILLED) )
@@ -7,6 +7,8 @@
  */
 #include "boxedinio.h"
 
+#include <stdint.h>
+#include <algorithm>
 #include <cstring>
 #include <chrono>
 #include <iostream>
@@ -43,11 +45,55 @@ void ParseCharMap(istream& in, vector<vector<char> >& charmap)
     }
 }
 
+// Crop the charmap to the bounding box of its chars that are not space (').
+// Space is never reached by the player or a box, so every tile outside of
+// the box only inflates the tile indexes and the tables indexed by them.
+// A solution is a list of moves, not coordinates, so it solves the original
+// level as well.
+bool TrimCharMap(vector<vector<char> >& charmap)
+{
+    size_t top = charmap.size();
+    size_t bottom = 0;
+    size_t left = SIZE_MAX;
+    size_t right = 0;
+    for (size_t y = 0; y < charmap.size(); y++)
+    {
+        for (size_t x = 0; x < charmap[y].size(); x++)
+        {
+            if (charmap[y][x] != '\'')
+            {
+                top = min(top, y);
+                bottom = max(bottom, y);
+                left = min(left, x);
+                right = max(right, x);
+            }
+        }
+    }
+    if (top == charmap.size() ||
+        (top == 0 && bottom == charmap.size() - 1 && left == 0 &&
+         right == charmap[0].size() - 1))
+    {
+        return false; // nothing but space, or nothing to trim
+    }
+
+    vector<vector<char> > trimmed;
+    for (size_t y = top; y <= bottom; y++)
+    {
+        const vector<char>& row = charmap[y];
+        // A short row stays short, so IsValidBoxedInLevel() still rejects it
+        size_t end = min(right + 1, row.size());
+        trimmed.push_back(vector<char>(row.begin() + min(left, end), row.begin() + end));
+    }
+    charmap.swap(trimmed);
+    return true;
+}
+
 bool IsValidBoxedInLevel(vector<vector<char> >& charmap)
 {
     int player_chars_found = 0;
     int exit_chars_found = 0;
     int invalid_chars_found = 0;
+    int gear_chars_found = 0;
     for (size_t y = 0; y < charmap.size(); y++)
     {
         if (y > 0 && charmap[y].size() != charmap[y-1].size())
@@ -62,7 +108,10 @@ bool IsValidBoxedInLevel(vector<vector<char> >& charmap)
             case ' ':  // floor
             case 'x':  // wall
             case '+':  // box
+                break;
             case '*':  // gear
+                gear_chars_found++;
+                break;
             case 'r':  // switch
             case 'o':  // switch
             case 'y':  // switch
@@ -97,8 +146,26 @@ bool IsValidBoxedInLevel(vector<vector<char> >& charmap)
     {
         fprintf(stderr, "Invalid level file: %d exit chars found\n", exit_chars_found);
     }
+
+    // The limits this solver was built with (see config.h)
+    size_t width = charmap.empty() ? 0 : charmap[0].size();
+    size_t tiles = width * charmap.size();
+    bool fits = true;
+    if (tiles > BOARD_TILES_MAX || width >= 64)
+    {
+        fprintf(stderr, "Level has %lu tiles (%lu columns); this build supports %d tiles "
+                "and 63 columns. Rebuild with a larger -DBOARD_TILES_MAX.\n",
+                tiles, width, BOARD_TILES_MAX);
+        fits = false;
+    }
+    if (gear_chars_found > GEARS_MAX)
+    {
+        fprintf(stderr, "Level has %d gears; this build supports %d. Rebuild with a "
+                "larger -DGEARS_MAX.\n", gear_chars_found, GEARS_MAX);
+        fits = false;
+    }
     return ( player_chars_found == 1 && exit_chars_found == 1 &&
-             invalid_chars_found == 0);
+             invalid_chars_found == 0 && fits);
 }
 
 // The path file contains directions to solve the level.
@@ -377,6 +444,7 @@ ostream& operator<<(ostream& out, const SearchResult& result)
     if (result.success)
     {
         out << "Level can be solved in " << result.num_moves << " moves" << endl;
+        out << "Suboptimality bound " << result.suboptimality_bound << endl;
     }
 
     out << "A* search time was ";
@@ -413,6 +481,40 @@ ostream& operator<<(ostream& out, const SearchResult& result)
 
     out << "Nodes in open set " << result.openset_size << endl;
     out << "Nodes in closed set " << result.closedset_size << endl;
+    out << "Nodes expanded " << result.nodes_expanded << endl;
+    if (result.last_layer_expanded)
+    {
+        out << "Nodes expanded in last fscore layer " << result.last_layer_expanded << endl;
+    }
+    if (result.pruned.unsolvable)
+    {
+        out << "Expansions pruned as unsolvable " << result.pruned.unsolvable << endl;
+    }
+    if (result.pruned.dead_pushes)
+    {
+        out << "Pushes pruned at choke points " << result.pruned.dead_pushes << endl;
+    }
+    if (result.pruned.dead_patterns)
+    {
+        out << "Pushes pruned by deadlock patterns " << result.pruned.dead_patterns << endl;
+    }
+    if (result.pruned.tunnel_states)
+    {
+        out << "States skipped in tunnels " << result.pruned.tunnel_states << endl;
+    }
+    if (result.states_merged)
+    {
+        out << "States merged by player region " << result.states_merged << endl;
+    }
+    for (size_t i = 0; i < result.arena_bytes.size(); i++)
+    {
+        out << "Arena " << result.arena_bytes[i].first << " "
+            << result.arena_bytes[i].second << " bytes" << endl;
+    }
+    if (result.arena_mapped)
+    {
+        out << "Arena mapped " << result.arena_mapped << " bytes" << endl;
+    }
 
     out << result.memusage << endl;
 
@@ -22,6 +22,8 @@ namespace io {
 
 bool ParseSolution(std::istream& in, std::vector<char>& path);
 void ParseCharMap(std::istream& in, std::vector<std::vector<char> >& charmap);
+/** \returns true if the charmap had rows or columns of space to trim. */
+bool TrimCharMap(std::vector<std::vector<char> >& charmap);
 bool IsValidBoxedInLevel(std::vector<std::vector<char> >& charmap);
 
 } // namespace
@@ -104,6 +104,17 @@ typedef uint64_t gears_bitfield_t;
 #endif
 /**@}*/
 
+#if BOARD_TILES_MAX % 64 != 0
+#error "BOARD_TILES_MAX must be a multiple of 64"
+#endif
+
+/** Index of a tile of the level (y * width + x). */
+#if BOARD_TILES_MAX <= 256
+typedef uint8_t tile_index_t;
+#else
+typedef uint16_t tile_index_t;
+#endif
+
 
 
 /** An x/y coordinate. */
@@ -1,11 +1,24 @@
 #pragma once
 
-// Define max number of gears allowed
+// Define max number of gears allowed. Levels with more gears are rejected;
+// build with e.g. -DGEARS_MAX=32 to solve them.
 #define GEARS_8 8
 #define GEARS_16 16
 #define GEARS_32 32
 #define GEARS_64 64
+#ifndef GEARS_MAX
 #define GEARS_MAX GEARS_16
+#endif
+
+// Define max number of tiles (width * height) of a level, a multiple of 64.
+// Boxes are stored one bit per tile, so each 64 tiles add 8 bytes to every
+// Node. Every level of the game fits in 192 tiles; build with e.g.
+// -DBOARD_TILES_MAX=256 to solve larger ones. solve also has the engines
+// built with 128 tiles and runs smaller levels on them (see solve_level.h).
+#ifndef BOARD_TILES_MAX
+#define BOARD_TILES_MAX 192
+#endif
+#define BOARD_WORDS (BOARD_TILES_MAX / 64)
 
 // Limit the search for solutions to this number of moves
 #define MAX_FSCORE 200
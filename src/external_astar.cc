@@ -0,0 +1,609 @@
+/**
+ * \file external_astar.cc
+ * \brief External-memory A* implementation of Boxed In Level-Solver.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <list>
+#include <map>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "external_astar.h"
+#include "astar.h"
+#include "config.h"
+#include "Node.h"
+
+using namespace std;
+
+namespace boxedin {
+
+namespace {
+
+// Records read or written per fread()/fwrite()
+#define EXTERNAL_IO_RECORDS 4096
+
+
+/**
+   \struct StateRecord
+   \brief Fixed-width on-disk form of a Node.
+
+   The gscore and hscore are implied by the bucket the record is in. The
+   parent is identified by its hash and gscore, which is enough to find it
+   again when the solution is rebuilt.
+ */
+struct StateRecord
+{
+    uint64_t boxes[BoxDescriptorLite::size];
+    uint64_t parent_hash;
+    gears_bitfield_t gears;
+    uint8_t player_x;
+    uint8_t player_y;
+    uint16_t parent_gscore;
+    uint16_t reserved;
+};
+
+// Order by state only; records of the same state compare equal.
+bool operator<(const StateRecord& l, const StateRecord& r)
+{
+    for (int i = 0; i < BoxDescriptorLite::size; i++)
+    {
+        if (l.boxes[i] != r.boxes[i])
+        {
+            return l.boxes[i] < r.boxes[i];
+        }
+    }
+    if (l.gears != r.gears)
+    {
+        return l.gears < r.gears;
+    }
+    if (l.player_y != r.player_y)
+    {
+        return l.player_y < r.player_y;
+    }
+    return l.player_x < r.player_x;
+}
+
+bool same_state(const StateRecord& l, const StateRecord& r)
+{
+    return !(l < r) && !(r < l);
+}
+
+
+StateRecord make_record(const Node& node, const Node* parent)
+{
+    StateRecord record;
+    memset(&record, 0, sizeof(record));
+    for (int i = 0; i < BoxDescriptorLite::size; i++)
+    {
+        record.boxes[i] = node.box_descriptor_.bitfields[i];
+    }
+    record.gears = node.gear_descriptor_.bitfield;
+    record.player_x = node.player_coord_.x;
+    record.player_y = node.player_coord_.y;
+    if (parent)
+    {
+        record.parent_hash = parent->hash_;
+        record.parent_gscore = (uint16_t)parent->gscore_;
+    }
+    return record;
+}
+
+
+// Overwrite the state of node (a copy of the start Node) with record.
+void load_record(const Level& level, const StateRecord& record,
+                 cost_t gscore, cost_t hscore, Node& node)
+{
+    for (int i = 0; i < BoxDescriptorLite::size; i++)
+    {
+        node.box_descriptor_.bitfields[i] = record.boxes[i];
+    }
+    node.gear_descriptor_.bitfield = record.gears;
+    node.player_coord_.x = record.player_x;
+    node.player_coord_.y = record.player_y;
+    node.predecessor_ = NODE_INDEX_NONE;
+    node.gscore_ = (uint16_t)gscore;
+    node.set_hscore(hscore);
+    node.hash_ = node.ComputeHash(level);
+}
+
+
+FILE* open_file(const string& path, const char* mode)
+{
+    FILE* file = fopen(path.c_str(), mode);
+    if (file == NULL)
+    {
+        throw runtime_error("cannot open " + path + ": " + strerror(errno));
+    }
+    return file;
+}
+
+
+void write_records(FILE* file, const StateRecord* records, size_t count)
+{
+    if (count && fwrite(records, sizeof(StateRecord), count, file) != count)
+    {
+        throw runtime_error(string("cannot write search data: ") + strerror(errno));
+    }
+}
+
+
+/**
+   \class RunReader
+   \brief Sequential reader of a sorted run, either a file or a sorted vector
+          that is still in memory.
+ */
+class RunReader
+{
+public:
+    explicit RunReader(const string& path)
+        : file_(open_file(path, "rb"))
+        , buffer_(EXTERNAL_IO_RECORDS)
+        , data_(NULL)
+        , pos_(0)
+        , count_(0)
+    {
+        Fill();
+    }
+
+    explicit RunReader(const vector<StateRecord>& records)
+        : file_(NULL)
+        , data_(records.empty() ? NULL : &records[0])
+        , pos_(0)
+        , count_(records.size())
+    {
+    }
+
+    ~RunReader()
+    {
+        if (file_)
+        {
+            fclose(file_);
+        }
+    }
+
+    bool done() const { return pos_ == count_; }
+    const StateRecord& peek() const { return data_[pos_]; }
+
+    void next()
+    {
+        pos_++;
+        if (pos_ == count_ && file_)
+        {
+            Fill();
+        }
+    }
+
+private:
+    void Fill()
+    {
+        count_ = fread(&buffer_[0], sizeof(StateRecord), buffer_.size(), file_);
+        data_ = &buffer_[0];
+        pos_ = 0;
+    }
+
+    FILE* file_;
+    vector<StateRecord> buffer_;
+    const StateRecord* data_;
+    size_t pos_;
+    size_t count_;
+
+    RunReader(const RunReader& other); // no copy
+    RunReader& operator=(const RunReader& other); // no copy
+};
+
+
+struct RunReaderGreater
+{
+    bool operator()(const RunReader* l, const RunReader* r) const
+    {
+        return r->peek() < l->peek();
+    }
+};
+
+
+// Successors waiting to be expanded that share a gscore and hscore
+struct Bucket
+{
+    vector<string> runs;         // sorted run files
+    vector<StateRecord> buffer;  // not yet written
+};
+
+// A closed bucket file; every record in it has been expanded
+struct ClosedRun
+{
+    cost_t gscore;
+    string path;
+    size_t count;
+};
+
+
+class ExternalSearch
+{
+public:
+    ExternalSearch(const Level& level, Heuristic& heuristic,
+                   const string& directory, size_t memory_bytes)
+        : level_(level)
+        , heuristic_(heuristic)
+        , max_buffered_(memory_bytes / sizeof(StateRecord))
+        , buffered_(0)
+        , file_count_(0)
+        , expanded_(0)
+        , closed_count_(0)
+        , pending_count_(0)
+    {
+        if (max_buffered_ == 0)
+        {
+            max_buffered_ = 1;
+        }
+        string dir_template = directory + "/boxedin-XXXXXX";
+        vector<char> path(dir_template.begin(), dir_template.end());
+        path.push_back('\0');
+        if (mkdtemp(&path[0]) == NULL)
+        {
+            throw runtime_error("cannot create a directory in " + directory + ": " +
+                                strerror(errno));
+        }
+        directory_ = &path[0];
+    }
+
+    ~ExternalSearch()
+    {
+        for (size_t i = 0; i < files_.size(); i++)
+        {
+            unlink(files_[i].c_str());
+        }
+        rmdir(directory_.c_str());
+    }
+
+    void Run(const Node& start, SearchResult& result)
+    {
+        if (start.fscore() < MAX_FSCORE)
+        {
+            Add(make_record(start, NULL), start.gscore_, start.hscore_);
+        }
+
+        while (!pending_.empty())
+        {
+            BucketKey key = pending_.begin()->first;
+            cost_t fscore = key.first;
+            cost_t gscore = key.second;
+            cost_t hscore = fscore - gscore;
+
+            StateRecord goal;
+            if (ExpandBucket(start, gscore, hscore, goal))
+            {
+                result.nodes_expanded = expanded_;
+                result.pruned = pruned_;
+                Node* node = Rebuild(start, goal, gscore);
+                result.SetSucceeded(level_, node, pending_count_, closed_count_);
+                while (node)
+                {
+                    Node* predecessor = node->predecessor();
+                    delete node;
+                    node = predecessor;
+                }
+                return;
+            }
+        }
+
+        result.nodes_expanded = expanded_;
+        result.pruned = pruned_;
+        result.SetFailed(0, closed_count_);
+    }
+
+private:
+    typedef pair<cost_t, cost_t> BucketKey; // fscore, gscore
+
+    string NewFile(const char* kind, cost_t gscore, cost_t hscore)
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "/%s-%d-%d-%lu.dat", kind, gscore, hscore,
+                 (unsigned long)file_count_++);
+        files_.push_back(directory_ + name);
+        return files_.back();
+    }
+
+    void Add(const StateRecord& record, cost_t gscore, cost_t hscore)
+    {
+        pending_[BucketKey(gscore + hscore, gscore)].buffer.push_back(record);
+        pending_count_++;
+        if (++buffered_ >= max_buffered_)
+        {
+            Flush();
+        }
+    }
+
+    // Write every buffer as a sorted run without duplicates.
+    void Flush()
+    {
+        map<BucketKey, Bucket>::iterator it;
+        for (it = pending_.begin(); it != pending_.end(); ++it)
+        {
+            vector<StateRecord>& buffer = it->second.buffer;
+            if (buffer.empty())
+            {
+                continue;
+            }
+            cost_t gscore = it->first.second;
+            cost_t hscore = it->first.first - gscore;
+            Unique(buffer);
+
+            string path = NewFile("run", gscore, hscore);
+            FILE* file = open_file(path, "wb");
+            write_records(file, &buffer[0], buffer.size());
+            fclose(file);
+
+            it->second.runs.push_back(path);
+            vector<StateRecord>().swap(buffer);
+        }
+        buffered_ = 0;
+    }
+
+    void Unique(vector<StateRecord>& records)
+    {
+        sort(records.begin(), records.end());
+        size_t before = records.size();
+        records.erase(unique(records.begin(), records.end(), same_state), records.end());
+        pending_count_ -= before - records.size();
+    }
+
+    // Merge the runs of bucket (gscore, hscore), drop states that are already
+    // closed, write the survivors to a closed run and expand them. Returns
+    // true with goal set if a goal state was found.
+    bool ExpandBucket(const Node& start, cost_t gscore, cost_t hscore, StateRecord& goal)
+    {
+        BucketKey key(gscore + hscore, gscore);
+        Bucket bucket;
+        bucket.runs.swap(pending_[key].runs);
+        bucket.buffer.swap(pending_[key].buffer);
+        pending_.erase(key);
+        buffered_ -= bucket.buffer.size();
+        Unique(bucket.buffer);
+
+        priority_queue<RunReader*, vector<RunReader*>, RunReaderGreater> runs;
+        vector<RunReader*> readers;
+        for (size_t i = 0; i < bucket.runs.size(); i++)
+        {
+            readers.push_back(new RunReader(bucket.runs[i]));
+        }
+        readers.push_back(new RunReader(bucket.buffer));
+        for (size_t i = 0; i < readers.size(); i++)
+        {
+            if (!readers[i]->done())
+            {
+                runs.push(readers[i]);
+            }
+        }
+
+        // A state has the same hscore wherever it is found, so it can only be
+        // a duplicate of a closed state with this hscore.
+        vector<RunReader*> closed;
+        vector<ClosedRun>& closed_runs = closed_[hscore];
+        for (size_t i = 0; i < closed_runs.size(); i++)
+        {
+            if (closed_runs[i].gscore <= gscore)
+            {
+                closed.push_back(new RunReader(closed_runs[i].path));
+            }
+        }
+
+        ClosedRun closed_run;
+        closed_run.gscore = gscore;
+        closed_run.path = NewFile("closed", gscore, hscore);
+        closed_run.count = 0;
+        FILE* closed_file = open_file(closed_run.path, "wb");
+        vector<StateRecord> closed_buffer;
+        closed_buffer.reserve(EXTERNAL_IO_RECORDS);
+
+        Node node(start);
+        bool found = false;
+        bool has_last = false;
+        StateRecord last;
+
+        while (!runs.empty() && !found)
+        {
+            RunReader* reader = runs.top();
+            runs.pop();
+            StateRecord record = reader->peek();
+            reader->next();
+            if (!reader->done())
+            {
+                runs.push(reader);
+            }
+            pending_count_--;
+
+            if (has_last && same_state(record, last))
+            {
+                continue;
+            }
+            has_last = true;
+            last = record;
+
+            if (IsClosed(closed, record))
+            {
+                continue;
+            }
+
+            closed_buffer.push_back(record);
+            if (closed_buffer.size() == EXTERNAL_IO_RECORDS)
+            {
+                write_records(closed_file, &closed_buffer[0], closed_buffer.size());
+                closed_buffer.clear();
+            }
+            closed_run.count++;
+            closed_count_++;
+
+            load_record(level_, record, gscore, hscore, node);
+            if (node.IsGoal(level_))
+            {
+                goal = record;
+                found = true;
+                break;
+            }
+
+            expanded_++;
+            list<Node*> successors = generate_successors(level_, heuristic_, node, &pruned_);
+            for (list<Node*>::iterator it = successors.begin(); it != successors.end(); ++it)
+            {
+                Node* successor = *it;
+                if (successor->hscore_ < MAX_FSCORE && successor->fscore() < MAX_FSCORE)
+                {
+                    Add(make_record(*successor, &node), successor->gscore_, successor->hscore_);
+                }
+                delete successor;
+            }
+        }
+
+        write_records(closed_file, closed_buffer.empty() ? NULL : &closed_buffer[0],
+                      closed_buffer.size());
+        fclose(closed_file);
+        closed_runs.push_back(closed_run);
+
+        for (size_t i = 0; i < readers.size(); i++)
+        {
+            delete readers[i];
+        }
+        for (size_t i = 0; i < closed.size(); i++)
+        {
+            delete closed[i];
+        }
+        for (size_t i = 0; i < bucket.runs.size(); i++)
+        {
+            unlink(bucket.runs[i].c_str());
+        }
+        return found;
+    }
+
+    // Records arrive in sorted order, so each closed run is read only once.
+    static bool IsClosed(vector<RunReader*>& closed, const StateRecord& record)
+    {
+        for (size_t i = 0; i < closed.size(); i++)
+        {
+            RunReader* reader = closed[i];
+            while (!reader->done() && reader->peek() < record)
+            {
+                reader->next();
+            }
+            if (!reader->done() && same_state(reader->peek(), record))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Follow the parent hashes back to the start state and replay the actions
+    // to build a chain of Nodes ending at the goal. The caller deletes the
+    // chain, from a copy of start to the goal.
+    Node* Rebuild(const Node& start, const StateRecord& goal, cost_t goal_gscore)
+    {
+        vector<ActionPoint> actions;
+        ActionVector parent_actions;
+        StateRecord record = goal;
+        cost_t gscore = goal_gscore;
+        Node child(start);
+        Node parent(start);
+
+        while (gscore > 0)
+        {
+            load_record(level_, record, gscore, 0, child);
+            cost_t parent_gscore = record.parent_gscore;
+
+            bool found = false;
+            map<cost_t, vector<ClosedRun> >::iterator it;
+            for (it = closed_.begin(); it != closed_.end() && !found; ++it)
+            {
+                for (size_t i = 0; i < it->second.size() && !found; i++)
+                {
+                    const ClosedRun& run = it->second[i];
+                    if (run.gscore != parent_gscore)
+                    {
+                        continue;
+                    }
+                    RunReader reader(run.path);
+                    for (; !reader.done() && !found; reader.next())
+                    {
+                        load_record(level_, reader.peek(), parent_gscore, it->first, parent);
+                        if (parent.hash_ != record.parent_hash)
+                        {
+                            continue;
+                        }
+                        find_actions(level_, parent, parent_actions);
+                        ActionVector::iterator action;
+                        for (action = parent_actions.begin(); action != parent_actions.end(); ++action)
+                        {
+                            Node successor(level_, heuristic_, parent, *action);
+                            push_through_tunnel(level_, successor);
+                            if (SameState(successor, child) && successor.gscore_ == gscore)
+                            {
+                                actions.push_back(*action);
+                                record = reader.peek();
+                                gscore = parent_gscore;
+                                found = true;
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+            if (!found)
+            {
+                throw runtime_error("cannot rebuild the solution path");
+            }
+        }
+
+        Node* node = new Node(start);
+        for (size_t i = actions.size(); i > 0; i--)
+        {
+            node = new Node(level_, heuristic_, *node, actions[i - 1]);
+            push_through_tunnel(level_, *node);
+        }
+        return node;
+    }
+
+    const Level& level_;
+    Heuristic& heuristic_;
+    string directory_;
+    size_t max_buffered_;
+    size_t buffered_;
+    unsigned long file_count_;
+    vector<string> files_;
+    map<BucketKey, Bucket> pending_;
+    map<cost_t, vector<ClosedRun> > closed_; // indexed by hscore
+    uint64_t expanded_;
+    PruneCounts pruned_;
+    size_t closed_count_;
+    size_t pending_count_;
+};
+
+} // anonymous namespace
+
+
+SearchResult external_astar(Level& level, Heuristic& heuristic,
+                            const string& directory, size_t memory_bytes)
+{
+    SearchResult result;
+    Node* start = Node::MakeStartNode(level, heuristic);
+
+    ExternalSearch search(level, heuristic, directory, memory_bytes);
+    search.Run(*start, result);
+
+    delete start;
+    return result;
+}
+
+} // namespace boxedin
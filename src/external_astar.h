@@ -0,0 +1,43 @@
+/**
+ * \file external_astar.h
+ * \brief External-memory A* implementation of Boxed In Level-Solver.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ */
+#ifndef EXTERNAL_ASTAR_H__
+#define EXTERNAL_ASTAR_H__
+
+#include <stddef.h>
+
+#include <string>
+
+#include "boxedintypes.h"
+#include "SearchResult.h"
+#include "Level.h"
+#include "Heuristic.h"
+
+namespace boxedin {
+
+/**
+   \brief A* search that keeps its open set and closed set on disk.
+   \details States are stored as fixed-width records in buckets keyed by
+            (gscore, hscore). Successors are buffered in memory and written as
+            sorted runs. Duplicates are not detected when a state is generated.
+            Before a bucket is expanded, its runs are merged. Duplicate records
+            are dropped, along with states already in an earlier bucket with
+            the same hscore (a state always has the same hscore). The solution
+            is rebuilt from the parent hash stored in each record.
+   \param[in] level The level to solve.
+   \param[in] heuristic An admissible heuristic.
+   \param[in] directory Directory for the temporary files. A new
+              subdirectory is created in it and removed afterwards.
+   \param[in] memory_bytes How many bytes of successor records to buffer
+              before they are written to disk as sorted runs.
+ */
+SearchResult external_astar(Level& level, Heuristic& heuristic,
+                            const std::string& directory, size_t memory_bytes);
+
+} // namespace
+
+#endif
@@ -0,0 +1,398 @@
+/**
+ * \file hdastar.cc
+ * \brief Hash-distributed A* (HDA*) implementation of Boxed In Level-Solver.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ */
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "hdastar.h"
+#include "astar.h"
+#include "config.h"
+#include "BucketQueue.h"
+#include "Node.h"
+#include "TranspositionTable.h"
+
+using namespace std;
+
+namespace boxedin {
+
+namespace {
+
+// Successors for another worker are buffered and sent in batches of this many
+// Nodes, so the mailbox atomics are amortized.
+#define HDASTAR_BATCH_SIZE 64
+
+// Partially filled batches are also sent after this many expansions, so no
+// worker waits long for Nodes it owns.
+#define HDASTAR_FLUSH_INTERVAL 64
+
+struct MailBatch
+{
+    vector<Node*> nodes;
+    MailBatch* next;
+};
+
+
+/**
+   \class Mailbox
+   \brief Multiple-producer, single-consumer lock-free stack of MailBatches.
+ */
+class Mailbox
+{
+public:
+    Mailbox() : head_(NULL) {}
+
+    void Push(MailBatch* batch)
+    {
+        MailBatch* head = head_.load(memory_order_relaxed);
+        do
+        {
+            batch->next = head;
+        } while (!head_.compare_exchange_weak(head, batch,
+                                              memory_order_release,
+                                              memory_order_relaxed));
+    }
+
+    MailBatch* TakeAll()
+    {
+        if (head_.load(memory_order_relaxed) == NULL)
+        {
+            return NULL;
+        }
+        return head_.exchange(NULL, memory_order_acquire);
+    }
+
+private:
+    atomic<MailBatch*> head_;
+};
+
+
+struct Worker
+{
+    // Holds everything below; released when the worker is deleted
+    Arena arena;
+
+    // Every Node this worker creates comes from this pool
+    NodePool pool;
+
+    // The open set of the states this worker owns
+    BucketQueue open;
+
+    // This worker's shard of the open set and closed set
+    TranspositionTable table;
+
+    Mailbox inbox;
+
+    // Batch being filled for each destination worker
+    vector<MailBatch*> outbox;
+
+    uint64_t expanded;
+    uint64_t reopened;
+    PruneCounts pruned;
+
+    explicit Worker(int num_threads)
+        : pool(sizeof(Node), arena)
+        , open(MAX_FSCORE, BucketQueue::TIE_BREAK_LOW_H_LIFO, &arena)
+        , table(1 << 16, &arena)
+        , outbox(num_threads, (MailBatch*)NULL)
+        , expanded(0)
+        , reopened(0)
+    {
+    }
+};
+
+
+class HdaSearch
+{
+public:
+    HdaSearch(const Level& level, Heuristic& heuristic, int num_threads)
+        : level_(level)
+        , heuristic_(heuristic)
+        , num_threads_(num_threads)
+        , incumbent_(MAX_FSCORE)
+        , goal_(NULL)
+        , work_(num_threads)
+    {
+        for (int i = 0; i < num_threads_; i++)
+        {
+            workers_.push_back(new Worker(num_threads_));
+        }
+    }
+
+    // Deleting the workers releases every Node they created.
+    ~HdaSearch()
+    {
+        for (int i = 0; i < num_threads_; i++)
+        {
+            delete workers_[i];
+        }
+    }
+
+    void Run(Node* start)
+    {
+        if (start->fscore() < MAX_FSCORE)
+        {
+            Receive(*workers_[Owner(*start)], start);
+        }
+
+        vector<thread> threads;
+        for (int i = 0; i < num_threads_; i++)
+        {
+            threads.push_back(thread(&HdaSearch::WorkerMain, this, i));
+        }
+        for (int i = 0; i < num_threads_; i++)
+        {
+            threads[i].join();
+        }
+    }
+
+    void GetResult(SearchResult& result) const
+    {
+        size_t open_size = 0;
+        size_t closed_size = 0;
+        uint64_t expanded = 0;
+        uint64_t reopened = 0;
+        result.pruned = PruneCounts();
+        for (int i = 0; i < num_threads_; i++)
+        {
+            result.pruned += workers_[i]->pruned;
+            open_size += workers_[i]->table.open_size();
+            closed_size += workers_[i]->table.closed_size();
+            expanded += workers_[i]->expanded;
+            reopened += workers_[i]->reopened;
+        }
+        fprintf(stderr, "HDA* expanded %lu nodes (%lu reopened) on %d threads\n",
+                (unsigned long)expanded, (unsigned long)reopened, num_threads_);
+
+        result.nodes_expanded = expanded;
+        if (goal_)
+        {
+            result.SetSucceeded(level_, goal_, open_size, closed_size);
+        }
+        else
+        {
+            result.SetFailed(open_size, closed_size);
+        }
+    }
+
+private:
+    int Owner(const Node& node) const
+    {
+        return (int)(((node.hash_ >> 32) * (uint64_t)num_threads_) >> 32);
+    }
+
+    void WorkerMain(int id)
+    {
+        Worker& worker = *workers_[id];
+        bool active = true; // counted in work_
+        SetThreadNodePool(&worker.pool);
+
+        for (;;)
+        {
+            MailBatch* batch = worker.inbox.TakeAll();
+            if (batch)
+            {
+                if (!active)
+                {
+                    work_.fetch_add(1);
+                    active = true;
+                }
+                int64_t received = 0;
+                while (batch)
+                {
+                    for (size_t i = 0; i < batch->nodes.size(); i++)
+                    {
+                        Receive(worker, batch->nodes[i]);
+                    }
+                    received += (int64_t)batch->nodes.size();
+                    MailBatch* next = batch->next;
+                    delete batch;
+                    batch = next;
+                }
+                work_.fetch_sub(received);
+            }
+
+            if (!active)
+            {
+                // Nothing is in flight and no worker has anything to expand
+                if (work_.load() == 0)
+                {
+                    break;
+                }
+                this_thread::yield();
+                continue;
+            }
+
+            Node* node = NULL;
+            if (worker.open.MinPriority() < incumbent_.load(memory_order_relaxed))
+            {
+                node = worker.open.Pop();
+            }
+
+            if (node == NULL)
+            {
+                Flush(worker, true);
+                active = false;
+                work_.fetch_sub(1);
+                continue;
+            }
+
+            worker.table.Close(node);
+
+            if (node->IsGoal(level_))
+            {
+                RecordGoal(node);
+                continue;
+            }
+
+            worker.expanded++;
+            list<Node*> successors = generate_successors(level_, heuristic_, *node, &worker.pruned);
+            for (list<Node*>::iterator it = successors.begin(); it != successors.end(); ++it)
+            {
+                Node* successor = *it;
+                if (successor->fscore() >= incumbent_.load(memory_order_relaxed))
+                {
+                    delete successor;
+                    continue;
+                }
+                int owner = Owner(*successor);
+                if (owner == id)
+                {
+                    Receive(worker, successor);
+                }
+                else
+                {
+                    Send(worker, owner, successor);
+                }
+            }
+
+            Flush(worker, (worker.expanded % HDASTAR_FLUSH_INTERVAL) == 0);
+        }
+
+        SetThreadNodePool(NULL);
+    }
+
+    // Add a Node to the open set of the worker that owns it
+    void Receive(Worker& worker, Node* node)
+    {
+        if (node->fscore() >= incumbent_.load(memory_order_relaxed))
+        {
+            delete node;
+            return;
+        }
+
+        Node* previous = NULL;
+        switch (worker.table.Insert(node, &previous))
+        {
+        case TranspositionTable::INSERTED:
+            worker.open.Push(node);
+            break;
+        case TranspositionTable::IMPROVED:
+            // previous has not been expanded, so no other Node points to it
+            worker.open.Remove(previous);
+            delete previous;
+            worker.open.Push(node);
+            break;
+        case TranspositionTable::DUPLICATE_OPEN:
+            delete node;
+            break;
+        case TranspositionTable::DUPLICATE_CLOSED:
+            // Workers expand Nodes out of global fscore order, so a closed
+            // state can be reached again with a better gscore.
+            if (worker.table.Reopen(node))
+            {
+                worker.reopened++;
+                worker.open.Push(node);
+            }
+            else
+            {
+                delete node;
+            }
+            break;
+        }
+    }
+
+    void Send(Worker& worker, int owner, Node* node)
+    {
+        MailBatch*& batch = worker.outbox[owner];
+        if (batch == NULL)
+        {
+            batch = new MailBatch;
+            batch->nodes.reserve(HDASTAR_BATCH_SIZE);
+        }
+        batch->nodes.push_back(node);
+    }
+
+    void Flush(Worker& worker, bool flush_all)
+    {
+        for (int i = 0; i < num_threads_; i++)
+        {
+            MailBatch*& batch = worker.outbox[i];
+            if (batch && (flush_all || batch->nodes.size() >= HDASTAR_BATCH_SIZE))
+            {
+                // Count the Nodes as in flight before they can be received
+                work_.fetch_add((int64_t)batch->nodes.size());
+                workers_[i]->inbox.Push(batch);
+                batch = NULL;
+            }
+        }
+    }
+
+    void RecordGoal(Node* node)
+    {
+        lock_guard<mutex> lock(goal_mutex_);
+        if (node->gscore_ < incumbent_.load())
+        {
+            fprintf(stderr, "HDA* found a solution with %d moves\n", node->gscore_);
+            goal_ = node;
+            incumbent_.store(node->gscore_);
+        }
+    }
+
+    const Level& level_;
+    Heuristic& heuristic_;
+    int num_threads_;
+    vector<Worker*> workers_;
+
+    // Cost of the best solution found so far. Nodes with an fscore at or
+    // above it are pruned.
+    atomic<cost_t> incumbent_;
+    mutex goal_mutex_;
+    Node* goal_;
+
+    // Number of active workers plus the number of Nodes that have been sent
+    // but not yet received. An idle worker only becomes active by receiving
+    // a Node, so once this reaches 0 the search is over.
+    atomic<int64_t> work_;
+};
+
+} // anonymous namespace
+
+
+SearchResult hdastar(Level& level, Heuristic& heuristic, int num_threads)
+{
+    SearchResult result;
+
+    // The workers share the heuristic, so its lazily filled tables must be
+    // complete before they start.
+    heuristic.precompute();
+
+    Node* start = Node::MakeStartNode(level, heuristic);
+
+    HdaSearch search(level, heuristic, num_threads);
+    search.Run(start);
+    search.GetResult(result);
+
+    // The start Node came from the heap, not from a worker pool
+    delete start;
+
+    return result;
+}
+
+} // namespace boxedin
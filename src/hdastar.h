@@ -0,0 +1,35 @@
+/**
+ * \file hdastar.h
+ * \brief Hash-distributed A* (HDA*) implementation of Boxed In Level-Solver.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ */
+#ifndef HDASTAR_H__
+#define HDASTAR_H__
+
+#include "boxedintypes.h"
+#include "SearchResult.h"
+#include "Level.h"
+#include "Heuristic.h"
+
+namespace boxedin {
+
+/**
+   \brief Multi-threaded A* search.
+   \details Every state is owned by one worker thread, chosen by the state's
+            hash. Each worker has its own open set bucket queue and its own
+            shard of the transposition table. Successors are sent to their
+            owner through lock-free mailboxes. The search stops once no worker
+            has a Node with an fscore below the best solution found, so the
+            solution is optimal.
+   \param[in] level The level to solve.
+   \param[in] heuristic An admissible heuristic. Its precompute() is called
+              before the workers start.
+   \param[in] num_threads Number of worker threads.
+ */
+SearchResult hdastar(Level& level, Heuristic& heuristic, int num_threads);
+
+} // namespace
+
+#endif
@@ -0,0 +1,250 @@
+/**
+ * \file idastar.cc
+ * \brief Iterative-deepening A* (IDA*) implementation of Boxed In Level-Solver.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <list>
+
+#include "idastar.h"
+#include "astar.h"
+#include "config.h"
+#include "Node.h"
+
+using namespace std;
+
+namespace boxedin {
+
+namespace {
+
+// Search() returns this when the goal has been found
+#define IDASTAR_FOUND (-1)
+
+
+/**
+   \class TranspositionCache
+   \brief Fixed-size, direct-mapped cache of the states visited during the
+          current IDA* iteration and the best gscore each was reached with.
+
+   When an entry is overwritten the state is simply forgotten, so the cache
+   only saves work; it is never needed for correctness. States are compared by
+   their 64-bit Zobrist hash alone to keep an entry at 16 bytes.
+ */
+class TranspositionCache
+{
+public:
+    explicit TranspositionCache(size_t bytes)
+        : entries_(NULL)
+        , capacity_(0)
+        , used_(0)
+    {
+        if (bytes >= sizeof(Entry))
+        {
+            capacity_ = 1;
+            while (capacity_ * 2 * sizeof(Entry) <= bytes)
+            {
+                capacity_ <<= 1;
+            }
+            entries_ = new Entry[capacity_];
+            memset(entries_, 0, capacity_ * sizeof(Entry));
+        }
+    }
+
+    ~TranspositionCache()
+    {
+        delete[] entries_;
+    }
+
+    /**
+       \brief Record that node was visited during iteration.
+       \returns true if the state of node was already visited during iteration
+                with a gscore no worse than node's. Everything below node has
+                then already been searched with at least as much of the bound
+                left, so node can be pruned.
+     */
+    bool Visit(const Node& node, uint32_t iteration)
+    {
+        if (capacity_ == 0)
+        {
+            return false;
+        }
+        Entry& entry = entries_[node.hash_ & (capacity_ - 1)];
+        if (entry.iteration == iteration && entry.hash == node.hash_ &&
+            entry.gscore <= node.gscore_)
+        {
+            return true;
+        }
+        if (entry.iteration != iteration)
+        {
+            used_++;
+        }
+        entry.hash = node.hash_;
+        entry.gscore = node.gscore_;
+        entry.iteration = iteration;
+        return false;
+    }
+
+    /** Forget every entry; called when a new iteration starts. */
+    void NewIteration() { used_ = 0; }
+
+    size_t used() const { return used_; }
+
+private:
+    struct Entry
+    {
+        uint64_t hash;
+        int32_t gscore;
+        uint32_t iteration; // 0 is never used, so zeroed entries are empty
+    };
+
+    Entry* entries_;
+    size_t capacity_;
+    size_t used_;
+
+    TranspositionCache(const TranspositionCache& other); // no copy
+    TranspositionCache& operator=(const TranspositionCache& other); // no copy
+};
+
+
+// Try the most promising successors first so the last iteration finds the goal
+// early.
+bool is_more_promising(const Node* a, const Node* b)
+{
+    if (a->fscore() != b->fscore())
+    {
+        return a->fscore() < b->fscore();
+    }
+    return a->hscore_ < b->hscore_;
+}
+
+
+// Returns true if the state of node is also the state of one of its
+// predecessors.
+bool is_on_path(const Node& node)
+{
+    for (const Node* p = node.predecessor(); p; p = p->predecessor())
+    {
+        if (p->hash_ == node.hash_ && SameState(*p, node))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+class IdaSearch
+{
+public:
+    IdaSearch(const Level& level, Heuristic& heuristic, size_t cache_bytes,
+              DeadlockPatterns* patterns, SearchResult& result)
+        : level_(level)
+        , heuristic_(heuristic)
+        , cache_(cache_bytes)
+        , patterns_(patterns)
+        , result_(result)
+        , iteration_(0)
+        , expanded_(0)
+    {
+    }
+
+    void Run(Node& start)
+    {
+        cost_t bound = start.fscore();
+        while (bound < MAX_FSCORE)
+        {
+            iteration_++;
+            cache_.NewIteration();
+
+            cost_t next_bound = Search(start, bound);
+            if (next_bound == IDASTAR_FOUND)
+            {
+                return;
+            }
+            bound = next_bound;
+        }
+        result_.nodes_expanded = expanded_;
+        result_.SetFailed(0, cache_.used());
+    }
+
+private:
+    // Depth-first search below node. Returns IDASTAR_FOUND if the goal was
+    // found, otherwise the lowest fscore that exceeded bound.
+    cost_t Search(Node& node, cost_t bound)
+    {
+        if (node.fscore() > bound)
+        {
+            return node.fscore();
+        }
+
+        if (node.IsGoal(level_))
+        {
+            result_.nodes_expanded = expanded_;
+            result_.SetSucceeded(level_, &node, 0, cache_.used());
+            return IDASTAR_FOUND;
+        }
+
+        if (cache_.Visit(node, iteration_) || is_on_path(node))
+        {
+            return COST_INFINITY;
+        }
+
+        expanded_++;
+        list<Node*> successors = generate_successors(level_, heuristic_, node, &result_.pruned,
+                                                     patterns_);
+        successors.sort(is_more_promising);
+
+        cost_t next_bound = COST_INFINITY;
+        list<Node*>::iterator it;
+        for (it = successors.begin(); it != successors.end(); ++it)
+        {
+            cost_t t = Search(**it, bound);
+            if (t == IDASTAR_FOUND)
+            {
+                next_bound = IDASTAR_FOUND;
+                break;
+            }
+            if (t < next_bound)
+            {
+                next_bound = t;
+            }
+        }
+
+        for (it = successors.begin(); it != successors.end(); ++it)
+        {
+            delete *it;
+        }
+        return next_bound;
+    }
+
+    const Level& level_;
+    Heuristic& heuristic_;
+    TranspositionCache cache_;
+    DeadlockPatterns* patterns_;
+    SearchResult& result_;
+    uint32_t iteration_;
+    uint64_t expanded_;
+};
+
+} // anonymous namespace
+
+
+SearchResult idastar(Level& level, Heuristic& heuristic, size_t cache_bytes,
+                     DeadlockPatterns* patterns)
+{
+    SearchResult result;
+    Node* start = Node::MakeStartNode(level, heuristic);
+
+    IdaSearch search(level, heuristic, cache_bytes, patterns, result);
+    search.Run(*start);
+
+    delete start;
+    return result;
+}
+
+} // namespace boxedin
@@ -0,0 +1,41 @@
+/**
+ * \file idastar.h
+ * \brief Iterative-deepening A* (IDA*) implementation of Boxed In Level-Solver.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ */
+#ifndef IDASTAR_H__
+#define IDASTAR_H__
+
+#include <stddef.h>
+
+#include "boxedintypes.h"
+#include "SearchResult.h"
+#include "Level.h"
+#include "Heuristic.h"
+#include "DeadlockPatterns.h"
+
+namespace boxedin {
+
+/**
+   \brief Low-memory A* search.
+   \details A depth-first search is repeated with an increasing fscore bound,
+            so only the Nodes on the current path and their siblings are kept
+            in memory. A bounded transposition cache of states seen during the
+            current iteration prunes most of the re-expansions of states that
+            are reached by more than one path.
+   \param[in] level The level to solve.
+   \param[in] heuristic An admissible heuristic.
+   \param[in] cache_bytes Size of the transposition cache in bytes; 0 disables
+              the cache.
+   \param[in,out] patterns If not NULL, deadlock patterns to prune with and
+                  to learn into. Each iteration searches the same states
+                  again, so what one iteration learns prunes the next.
+ */
+SearchResult idastar(Level& level, Heuristic& heuristic, size_t cache_bytes,
+                     DeadlockPatterns* patterns = NULL);
+
+} // namespace
+
+#endif
@@ -13,16 +13,12 @@
 
 #include <cstdlib>
 #include <cstdio>
-#include <time.h>
 #include <fstream>
 #include <iostream>
 #include <string>
 #include <boost/program_options.hpp>
 #include "boxedinio.h"
-#include "astar.h"
-#include "Heuristic.h"
-#include "Level.h"
-#include "Node.h"
+#include "solve_level.h"
 
 
 #if defined (__linux__) || defined (__APPLE__)
@@ -36,9 +32,9 @@ using namespace boxedin;
 
 int main(int argc, char* argv[])
 {
-  string stats_path;
   string level_path;
   bool use_color = true;
+  SolveOptions options;
   
 #if defined (__linux__) || defined (__APPLE__)
   // Setup process signal handlers
@@ -52,8 +48,22 @@ int main(int argc, char* argv[])
     desc.add_options()
       ("help,h",                                                                  "Display help"                  )
       ("no-color,n",                                                              "Do not display level in color" )
-      ("stats,s", boost::program_options::value<string>(&stats_path),             "Output stats file"             )
+      ("stats,s", boost::program_options::value<string>(&options.stats_path),     "Output stats file"             )
       ("level,l", boost::program_options::value<string>(&level_path)->required(), "Input boxed-in level file"     )
+      ("threads,t", boost::program_options::value<int>(&options.num_threads),     "Number of search threads"      )
+      ("engine,e",  boost::program_options::value<string>(&options.engine),       "Search engine: astar, ida or external")
+      ("cache-mb",  boost::program_options::value<size_t>(&options.cache_mb),     "IDA* transposition cache size in MB (0 disables; default 64)")
+      ("weight,w",  boost::program_options::value<double>(&options.weight),       "Weighted A*: expand by g + W*h (W >= 1)")
+      ("anytime,a",                                                               "ARA*: report improving solutions while lowering the weight")
+      ("deadline",  boost::program_options::value<double>(&options.deadline),     "ARA* time limit in seconds"    )
+      ("disk-dir",  boost::program_options::value<string>(&options.disk_dir),     "External A* temporary file directory (default .)")
+      ("memory-mb", boost::program_options::value<size_t>(&options.memory_mb),    "External A* successor buffer size in MB (default 256)")
+      ("tie-break", boost::program_options::value<string>(&options.tie_break),    "A* order within an fscore: fifo, lifo, h-fifo or h-lifo (default)")
+      ("huge-pages",                                                              "A*: back the search memory with 2 MB pages")
+      ("merge-regions",                                                           "A*: merge states whose player is in the same region")
+      ("heuristic", boost::program_options::value<string>(&options.heuristic_name), "Heuristic: walk (default) or boxes (walk raised by the boxes in the way)")
+      ("learn",                                                                   "A* and IDA*: learn deadlock patterns during the search")
+      ("patterns",  boost::program_options::value<string>(&options.patterns_path), "Deadlock pattern file to start from and save to (implies --learn)")
       ;
     
     boost::program_options::positional_options_description positionalOptions;
@@ -79,6 +89,79 @@ int main(int argc, char* argv[])
     {
       use_color = false;
     }
+
+    if (options.num_threads < 1)
+    {
+      cerr << "threads must be at least 1" << endl;
+      return 1;
+    }
+
+    if (options.engine != "astar" && options.engine != "ida" && options.engine != "external")
+    {
+      cerr << "unknown search engine: " << options.engine << endl;
+      return 1;
+    }
+
+    if (options.heuristic_name != "walk" && options.heuristic_name != "boxes")
+    {
+      cerr << "unknown heuristic: " << options.heuristic_name << endl;
+      return 1;
+    }
+
+    if (options.weight < 1.0)
+    {
+      cerr << "weight must be at least 1" << endl;
+      return 1;
+    }
+
+    if (options.tie_break != "fifo" && options.tie_break != "lifo" &&
+        options.tie_break != "h-fifo" && options.tie_break != "h-lifo")
+    {
+      cerr << "tie-break must be fifo, lifo, h-fifo or h-lifo" << endl;
+      return 1;
+    }
+
+    if (variablesMap.count("huge-pages"))
+    {
+      options.huge_pages = true;
+    }
+
+    if (variablesMap.count("merge-regions"))
+    {
+      options.merge_regions = true;
+    }
+
+    if (variablesMap.count("learn") || !options.patterns_path.empty())
+    {
+      options.learn = true;
+    }
+
+    if (variablesMap.count("anytime"))
+    {
+      options.anytime = true;
+      if (!variablesMap.count("weight"))
+      {
+        options.weight = 3.0;
+      }
+    }
+
+    // Reject the options that the engine picked would ignore
+    bool plain_astar = options.engine == "astar" && !options.anytime &&
+                       options.weight == 1.0 && options.num_threads == 1;
+    const char* astar_options[] = { "tie-break", "huge-pages", "merge-regions" };
+    for (size_t i = 0; i < sizeof(astar_options) / sizeof(astar_options[0]); i++)
+    {
+      if (variablesMap.count(astar_options[i]) && !plain_astar)
+      {
+        cerr << astar_options[i] << " only applies to A* without weight, anytime or threads" << endl;
+        return 1;
+      }
+    }
+    if (options.learn && !plain_astar && options.engine != "ida")
+    {
+      cerr << "learn and patterns only apply to IDA* and to A* without weight, anytime or threads" << endl;
+      return 1;
+    }
   }
   catch (boost::program_options::error& e)
   {
@@ -102,56 +185,29 @@ int main(int argc, char* argv[])
     return 1;
   }
 
+  cerr << "Boxed In Level:" << endl;
+  PrintCharMap(cerr, charmap, use_color);
+
+  // Trim unnecessary rows and columns and re-print the level
+  if (boxedin::io::TrimCharMap(charmap))
+  {
+    cerr << "Trimmed Level:" << endl;
+    PrintCharMap(cerr, charmap, use_color);
+  }
+
   if (!boxedin::io::IsValidBoxedInLevel(charmap))
   {
     fprintf(stderr, "ERROR: Invalid boxed in level\n");
     return 1;
   }
-
-  cerr << "Boxed In Level:" << endl;
-  PrintCharMap(cerr, charmap, use_color);
-
-  // TODO: trim unnecessary rows and columns and re-print the level
     
-  // A* Search
-  time_t rawtime;
-  struct tm* timeinfo;
-
-  time(&rawtime);
-  timeinfo = localtime(&rawtime);
-  cerr << asctime(timeinfo) << endl;
-
-  Level level = Level::MakeLevel(charmap);
-
-  ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
-  SearchResult result = astar(level, heuristic);
-    
-  time(&rawtime);
-  timeinfo = localtime(&rawtime);
-  cerr << asctime(timeinfo) << endl;
-
-  if (result.success)
+  // Run on 2-word Nodes if the level fits in them (see solve_level.h)
+  size_t tiles = charmap.size() * charmap[0].size();
+  if (BOARD_TILES_MAX > SOLVE_LEVEL_NARROW_TILES && tiles <= SOLVE_LEVEL_NARROW_TILES)
   {
-    cerr << "A* search succeeded" << endl;
-    // write stats to file or stderr
-    if (!stats_path.empty())
-    {
-      ofstream stats_output(stats_path.c_str());
-      stats_output << result << endl;
-    }
-    else
-    {
-      cerr << result << endl;
-    }
-
-    // write solution to stdout
-    cout << result.solution << endl;
-
-    return 0;
+    return boxedin_128::solve_level(options, charmap);
   }
-
-  cerr << "A* search failed" << endl;
-  return 1;
+  return solve_level(options, charmap);
 }
 
 
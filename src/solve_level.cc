@@ -0,0 +1,152 @@
+/**
+ * \file solve_level.cc
+ * \brief Run the search engine picked on the command line on one level.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ */
+
+#include <time.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include "solve_level.h"
+#include "boxedinio.h"
+#include "arastar.h"
+#include "astar.h"
+#include "BucketQueue.h"
+#include "DeadlockPatterns.h"
+#include "external_astar.h"
+#include "hdastar.h"
+#include "idastar.h"
+#include "Heuristic.h"
+#include "Level.h"
+#include "Node.h"
+#include "SearchContext.h"
+
+
+using namespace std;
+
+
+namespace boxedin
+{
+
+int solve_level(const SolveOptions& options, const vector<vector<char> >& charmap)
+{
+  BucketQueue::TieBreaking tie_breaking = BucketQueue::TIE_BREAK_LOW_H_LIFO;
+  if (options.tie_break == "fifo")
+  {
+    tie_breaking = BucketQueue::TIE_BREAK_FIFO;
+  }
+  else if (options.tie_break == "lifo")
+  {
+    tie_breaking = BucketQueue::TIE_BREAK_LIFO;
+  }
+  else if (options.tie_break == "h-fifo")
+  {
+    tie_breaking = BucketQueue::TIE_BREAK_LOW_H_FIFO;
+  }
+
+  cerr << "Node size " << sizeof(Node) << " bytes (" << BOARD_TILES_MAX
+       << " tiles)" << endl;
+
+  // A* Search
+  time_t rawtime;
+  struct tm* timeinfo;
+
+  time(&rawtime);
+  timeinfo = localtime(&rawtime);
+  cerr << asctime(timeinfo) << endl;
+
+  Level level = Level::MakeLevel(charmap);
+
+  // The terms are built once; --heuristic picks a stack of them
+  ShortestDistanceThroughGearsToExitHeuristic walk(level);
+  FirstPushHeuristic first_push(level, walk);
+  MaxHeuristic<ShortestDistanceThroughGearsToExitHeuristic, FirstPushHeuristic> boxes(walk, first_push);
+  map<string, Heuristic*> heuristics;
+  heuristics["walk"] = &walk;
+  heuristics["boxes"] = &boxes;
+  Heuristic& heuristic = *heuristics[options.heuristic_name];
+
+  DeadlockPatterns patterns(level);
+  if (!options.patterns_path.empty())
+  {
+    if (patterns.Load(options.patterns_path))
+    {
+      cerr << "Loaded " << patterns.size() << " deadlock patterns, "
+           << patterns.instances() << " in this level" << endl;
+    }
+  }
+
+  SearchResult result;
+  if (options.engine == "ida")
+  {
+    result = idastar(level, heuristic, options.cache_mb << 20, options.learn ? &patterns : NULL);
+  }
+  else if (options.engine == "external")
+  {
+    result = external_astar(level, heuristic, options.disk_dir, options.memory_mb << 20);
+  }
+  else if (options.anytime)
+  {
+    result = arastar(level, heuristic, options.weight, options.deadline);
+  }
+  else if (options.weight > 1.0)
+  {
+    result = weighted_astar(level, heuristic, options.weight);
+  }
+  else if (options.num_threads > 1)
+  {
+    result = hdastar(level, heuristic, options.num_threads);
+  }
+  else
+  {
+    SearchContext context(options.huge_pages);
+    if (options.learn)
+    {
+      context.set_patterns(&patterns);
+    }
+    result = astar(context, level, heuristic, tie_breaking, options.merge_regions);
+  }
+
+  if (options.learn)
+  {
+    cerr << "Deadlock patterns learned " << patterns.learned()
+         << ", pushes matched " << patterns.hits() << endl;
+  }
+  if (!options.patterns_path.empty() && !patterns.Save(options.patterns_path))
+  {
+    cerr << "cannot write " << options.patterns_path << endl;
+  }
+
+  time(&rawtime);
+  timeinfo = localtime(&rawtime);
+  cerr << asctime(timeinfo) << endl;
+
+  if (result.success)
+  {
+    cerr << "A* search succeeded" << endl;
+    // write stats to file or stderr
+    if (!options.stats_path.empty())
+    {
+      ofstream stats_output(options.stats_path.c_str());
+      stats_output << result << endl;
+    }
+    else
+    {
+      cerr << result << endl;
+    }
+
+    // write solution to stdout
+    cout << result.solution << endl;
+
+    return 0;
+  }
+
+  cerr << "A* search failed" << endl;
+  return 1;
+}
+
+} // namespace boxedin
@@ -0,0 +1,73 @@
+/**
+ * \file solve_level.h
+ * \brief Run the search engine picked on the command line on one level.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ */
+#ifndef SOLVE_LEVEL_H__
+#define SOLVE_LEVEL_H__
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+/**
+   \struct SolveOptions
+   \brief The search options of solve. Plain types only, so that both builds
+          of solve_level() below take the same struct.
+ */
+struct SolveOptions
+{
+    std::string stats_path;
+    int num_threads;
+    std::string engine;
+    size_t cache_mb;
+    double weight;
+    bool anytime;
+    double deadline;
+    std::string disk_dir;
+    size_t memory_mb;
+    std::string tie_break;
+    bool huge_pages;
+    bool merge_regions;
+    std::string heuristic_name;
+    bool learn;
+    std::string patterns_path;
+
+    SolveOptions()
+        : num_threads(1), engine("astar"), cache_mb(64), weight(1.0),
+          anytime(false), deadline(0), disk_dir("."), memory_mb(256),
+          tie_break("h-lifo"), huge_pages(false), merge_regions(false),
+          heuristic_name("walk"), learn(false)
+    {}
+};
+
+// The engines are built twice (see CMakeLists.txt): as boxedin, with the
+// BOARD_TILES_MAX of config.h, and as boxedin_128, with BOARD_TILES_MAX
+// 128. The second build's Nodes hold 2 box words instead of 3, which makes
+// them 40 bytes instead of 48. solve picks the smaller one that fits.
+#define SOLVE_LEVEL_NARROW_TILES 128
+
+namespace boxedin
+{
+
+/**
+   \brief Solve a level and write the stats and the solution.
+   \param[in] charmap A trimmed level that IsValidBoxedInLevel() accepts, of
+              at most BOARD_TILES_MAX tiles.
+   \returns The exit status of solve: 0 if a solution was found, else 1.
+ */
+int solve_level(const SolveOptions& options, const std::vector<std::vector<char> >& charmap);
+
+} // namespace boxedin
+
+namespace boxedin_128
+{
+
+int solve_level(const SolveOptions& options, const std::vector<std::vector<char> >& charmap);
+
+} // namespace boxedin_128
+
+#endif
@@ -156,4 +156,251 @@ TEST(FloodFill, canFindExpectedActionsLevel4State1)
     << "EXPECTED:\n" << ::testing::PrintToString(expectedActions) << std::endl
     << "ACTUAL:\n" << ::testing::PrintToString(actions)
     << "DIFFERENCE:\n" << ::testing::PrintToString(difference);
-}
\ No newline at end of file
+}
+
+TEST(FloodFill, cannotPushBoxOntoFilledGear)
+{
+  // The gear is filled before the tile to the right of the box is reached,
+  // so the push left must still see the gear.
+  auto level = Level::MakeLevel(
+      "''''''''''\n"
+      "'xxxxxxxx'\n"
+      "'xp     x'\n"
+      "'x*+    x'\n"
+      "'x      x'\n"
+      "'xxxxxx@x'\n"
+      "''''''''''\n"
+      "''''''''''\n"
+      "''''''''''\n"
+      "''''''''''\n"
+      "''''''''''\n"
+      "''''''''''\n"
+      "''''''''''\n"
+      "''''''''''\n"
+  );
+
+  ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+  auto node = Node::MakeStartNode(level, heuristic);
+  auto actions = find_actions(level, *node);
+  delete node;
+
+  bool found_gear = false;
+  for (const auto& action : actions)
+  {
+    if (action.point == Coord(2, 3))
+    {
+      found_gear = true;
+    }
+    if (action.point == Coord(3, 3))
+    {
+      EXPECT_NE(action.path.at(action.path.size() - 1), ENCODED_PATH_DIRECTION_LEFT)
+        << action;
+    }
+  }
+  EXPECT_TRUE(found_gear);
+}
+
+TEST(FloodFill, boxedInGearIsUnsolvable) {
+  auto boxed = Level::MakeLevel(
+      "''''''''''\n"
+      "''''''''''\n"
+      "''''''''''\n"
+      "''''''''''\n"
+      "'xxxxxxxx'\n"
+      "'x  x*x x'\n"
+      "'xp x+ @x'\n"
+      "'x     xx'\n"
+      "'xxxxxxxx'\n"
+      "''''''''''\n"
+      "''''''''''\n"
+      "''''''''''\n"
+      "''''''''''\n"
+      "''''''''''\n"
+  );
+  // Same level with the box one tile lower
+  auto open = Level::MakeLevel(
+      "''''''''''\n"
+      "''''''''''\n"
+      "''''''''''\n"
+      "''''''''''\n"
+      "'xxxxxxxx'\n"
+      "'x  x*x x'\n"
+      "'xp x  @x'\n"
+      "'x   + xx'\n"
+      "'xxxxxxxx'\n"
+      "''''''''''\n"
+      "''''''''''\n"
+      "''''''''''\n"
+      "''''''''''\n"
+      "''''''''''\n"
+  );
+
+  ShortestDistanceThroughGearsToExitHeuristic boxed_heuristic(boxed);
+  auto node = Node::MakeStartNode(boxed, boxed_heuristic);
+  EXPECT_TRUE(is_unsolvable(boxed, *node));
+  EXPECT_EQ(generate_successors(boxed, boxed_heuristic, *node).size(), 0);
+  delete node;
+
+  ShortestDistanceThroughGearsToExitHeuristic open_heuristic(open);
+  node = Node::MakeStartNode(open, open_heuristic);
+  EXPECT_FALSE(is_unsolvable(open, *node));
+  delete node;
+}
+
+TEST(FloodFill, edgeOfTrimmedLevelBoxesInLikeSpace) {
+  // The gear is on the first row; above it is the edge of the level
+  auto boxed = Level::MakeLevel(
+      "'''x*x'\n"
+      "xxxx+ x\n"
+      "xp    @\n"
+      "xxxxxxx\n"
+  );
+  auto open = Level::MakeLevel(
+      "'''x*x'\n"
+      "xxxx +x\n"
+      "xp    @\n"
+      "xxxxxxx\n"
+  );
+
+  ShortestDistanceThroughGearsToExitHeuristic boxed_heuristic(boxed);
+  auto node = Node::MakeStartNode(boxed, boxed_heuristic);
+  EXPECT_TRUE(is_unsolvable(boxed, *node));
+  delete node;
+
+  ShortestDistanceThroughGearsToExitHeuristic open_heuristic(open);
+  node = Node::MakeStartNode(open, open_heuristic);
+  EXPECT_FALSE(is_unsolvable(open, *node));
+  delete node;
+}
+
+TEST(FloodFill, findPathRebuildsThePathOfEachAction) {
+  auto level = Level::MakeLevel(
+      "''''''''''\n"
+      "''''''''''\n"
+      "''''''''''\n"
+      "''''''''''\n"
+      "'xxxxxxxx'\n"
+      "'x  +  xx'\n"
+      "'xp +  @x'\n"
+      "'x  +  xx'\n"
+      "'xxxxxxxx'\n"
+      "''''''''''\n"
+      "''''''''''\n"
+      "''''''''''\n"
+      "''''''''''\n"
+      "''''''''''\n"
+  );
+
+  ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+  auto node = Node::MakeStartNode(level, heuristic);
+  auto actions = find_actions(level, *node);
+  EXPECT_EQ(actions.size(), 3);
+  for (const auto& action : actions)
+  {
+    Node successor(level, heuristic, *node, action);
+    EXPECT_EQ(successor.gscore_, action.path.size());
+    EXPECT_TRUE(find_path(level, *node, successor) == action.path) << action;
+  }
+  delete node;
+}
+
+TEST(FloodFill, pushIntoDeadCornerInFrontOfTheExitIsPruned) {
+  // Pushed right, the box is stuck in the corner and the exit is behind it
+  auto level = Level::MakeLevel(
+      "xxxxxx\n"
+      "xp + x\n"
+      "xxxx@x\n"
+  );
+  const LevelBitboards& bb = level.bitboards_;
+  EXPECT_TRUE(bb.cuts_exit[ENCODED_PATH_DIRECTION_RIGHT].Test(bb.TileIndex(Coord(4, 1))));
+
+  ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+  auto node = Node::MakeStartNode(level, heuristic);
+  auto actions = find_actions(level, *node);
+  ASSERT_EQ(actions.size(), 1);
+  EXPECT_TRUE(is_dead_push(level, *node, ActionPoint(actions.front())));
+  EXPECT_EQ(generate_successors(level, heuristic, *node).size(), 0);
+  delete node;
+
+  // Here the box can still be pushed on, from the other side, so the push is kept
+  auto around = Level::MakeLevel(
+      "xxxxxxx\n"
+      "xp + *x\n"
+      "x xx xx\n"
+      "x   @x'\n"
+      "xxxxxx'\n"
+  );
+  ShortestDistanceThroughGearsToExitHeuristic around_heuristic(around);
+  node = Node::MakeStartNode(around, around_heuristic);
+  ActionPoint push(Coord(3, 1), ENCODED_PATH_DIRECTION_RIGHT, 2);
+  EXPECT_FALSE(is_dead_push(around, *node, push));
+  delete node;
+}
+
+TEST(FloodFill, pushIntoChokePointThatCutsOffTheExitIsPruned) {
+  // Pushed right, the box blocks the only way to the gear and the exit, and
+  // it could only be pushed on from below or above
+  auto level = Level::MakeLevel(
+      "xxxxxx\n"
+      "xxx*xx\n"
+      "xp+ xx\n"
+      "xxx xx\n"
+      "xxx@xx\n"
+      "xxxxxx\n"
+  );
+  const LevelBitboards& bb = level.bitboards_;
+  int choke = bb.TileIndex(Coord(3, 2));
+  EXPECT_TRUE(bb.articulation.Test(choke));
+  EXPECT_TRUE(bb.cuts_exit[ENCODED_PATH_DIRECTION_RIGHT].Test(choke));
+  EXPECT_EQ(bb.cut_gears[choke * 4 + ENCODED_PATH_DIRECTION_RIGHT], 1);
+
+  ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+  auto node = Node::MakeStartNode(level, heuristic);
+  auto actions = find_actions(level, *node);
+  ASSERT_EQ(actions.size(), 1);
+  EXPECT_TRUE(is_dead_push(level, *node, ActionPoint(actions.front())));
+  PruneCounts pruned;
+  EXPECT_EQ(generate_successors(level, heuristic, *node, &pruned).size(), 0);
+  EXPECT_EQ(pruned.dead_pushes, 1);
+  delete node;
+}
+
+TEST(FloodFill, pushOutOfADeadEndGoesOnThroughTheTunnel) {
+  // Behind the box the player has nothing to do, so it pushes the box on
+  // until it reaches the exit passage
+  auto level = Level::MakeLevel(
+      "xxxxxxx\n"
+      "xp+   x\n"
+      "xxxx@ x\n"
+      "xxxxxxx\n"
+  );
+  const LevelBitboards& bb = level.bitboards_;
+  EXPECT_TRUE(bb.tunnel[ENCODED_PATH_DIRECTION_RIGHT].Test(bb.TileIndex(Coord(3, 1))));
+  EXPECT_TRUE(bb.tunnel[ENCODED_PATH_DIRECTION_RIGHT].Test(bb.TileIndex(Coord(4, 1))));
+  EXPECT_FALSE(bb.tunnel[ENCODED_PATH_DIRECTION_RIGHT].Test(bb.TileIndex(Coord(5, 1))));
+
+  ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+  auto node = Node::MakeStartNode(level, heuristic);
+  PruneCounts pruned;
+  auto successors = generate_successors(level, heuristic, *node, &pruned);
+  ASSERT_EQ(successors.size(), 1);
+  Node* successor = successors.front();
+  EXPECT_EQ(successor->player_coord_, Coord(4, 1));
+  EXPECT_EQ(successor->gscore_, 3);
+  EXPECT_EQ(pruned.tunnel_states, 2);
+  EXPECT_EQ(successor->hash_, successor->ComputeHash(level));
+  EXPECT_EQ(find_path(level, *node, *successor).size(), 3);
+  delete successor;
+  delete node;
+
+  // Pushed on, the box would end up on the exit, so the push is dropped
+  auto blocked = Level::MakeLevel(
+      "xxxxxxxx\n"
+      "xp+   @x\n"
+      "xxxxxxxx\n"
+  );
+  ShortestDistanceThroughGearsToExitHeuristic blocked_heuristic(blocked);
+  node = Node::MakeStartNode(blocked, blocked_heuristic);
+  EXPECT_EQ(generate_successors(blocked, blocked_heuristic, *node).size(), 0);
+  delete node;
+}
@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+#include <arastar.h>
+#include <astar.h>
+#include <Heuristic.h>
+#include "test_levels.h"
+
+using namespace boxedin;
+using namespace testing;
+
+TEST(AraStar, weightedSolutionIsWithinReportedBound)
+{
+  auto level = MakeRedAndYellowGateLevel();
+  ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+  SearchResult optimal = astar(level, heuristic);
+  ASSERT_TRUE(optimal.success);
+
+  SearchResult result = weighted_astar(level, heuristic, 2.0);
+  ASSERT_TRUE(result.success);
+  EXPECT_EQ((int)result.solution.size(), result.num_moves);
+  EXPECT_GE(result.num_moves, optimal.num_moves);
+  EXPECT_GE(result.suboptimality_bound, 1.0);
+  EXPECT_LE(result.num_moves, result.suboptimality_bound * optimal.num_moves + 1e-9);
+}
+
+TEST(AraStar, anytimeSearchProvesOptimality)
+{
+  auto level = MakeRedAndYellowGateLevel();
+  ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+  SearchResult optimal = astar(level, heuristic);
+  ASSERT_TRUE(optimal.success);
+
+  SearchResult result = arastar(level, heuristic, 3.0, 0);
+  ASSERT_TRUE(result.success);
+  EXPECT_EQ(result.num_moves, optimal.num_moves);
+  EXPECT_DOUBLE_EQ(result.suboptimality_bound, 1.0);
+}
+
+TEST(AraStar, expiredDeadlineStillReportsAnUpperBound)
+{
+  // Weighted A* finds a 33-move solution before the first deadline check,
+  // after 256 expansions; proving the 25-move one takes more
+  auto level = Level::MakeLevel(
+      "xxx'xxx'''\n"
+      "x xxxgx'''\n"
+      "x     xxxx\n"
+      "xp+x+ GB@x\n"
+      "x     xxxx\n"
+      "xbxxx x'''\n"
+      "xxx''xx'''\n"
+  );
+  ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+  SearchResult optimal = astar(level, heuristic);
+  ASSERT_TRUE(optimal.success);
+
+  SearchResult result = arastar(level, heuristic, 3.0, 1e-9);
+  ASSERT_TRUE(result.success);
+  EXPECT_GT(result.num_moves, optimal.num_moves);
+  EXPECT_GT(result.suboptimality_bound, 1.0);
+  EXPECT_LE(result.num_moves, result.suboptimality_bound * optimal.num_moves + 1e-9);
+}
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+#include <set>
+#include <vector>
+#include <Arena.h>
+
+using namespace boxedin;
+using namespace testing;
+
+TEST(Arena, smallAllocationsAreAlignedAndCounted)
+{
+  Arena arena;
+  std::set<char*> seen;
+  for (size_t bytes = 1; bytes < 5000; bytes += 37)
+  {
+    char* p = (char*)arena.Allocate(bytes, Arena::CATEGORY_SUCCESSORS);
+    EXPECT_EQ((uintptr_t)p % 16, 0u);
+    memset(p, 0xAB, bytes);
+    EXPECT_TRUE(seen.insert(p).second);
+  }
+  EXPECT_GT(arena.bytes(Arena::CATEGORY_SUCCESSORS), 0u);
+  EXPECT_EQ(arena.bytes(Arena::CATEGORY_NODES), 0u);
+  EXPECT_GE(arena.mapped(), arena.bytes(Arena::CATEGORY_SUCCESSORS));
+}
+
+TEST(Arena, largeAllocationsAreReturnedByFree)
+{
+  Arena arena;
+  size_t bytes = ARENA_LARGE_ALLOCATION * 3;
+  char* p = (char*)arena.Allocate(bytes, Arena::CATEGORY_TRANSPOSITION_TABLE);
+  memset(p, 0, bytes);
+  EXPECT_EQ(arena.bytes(Arena::CATEGORY_TRANSPOSITION_TABLE), bytes);
+  EXPECT_GE(arena.mapped(), bytes);
+
+  arena.Free(p, bytes, Arena::CATEGORY_TRANSPOSITION_TABLE);
+  EXPECT_EQ(arena.bytes(Arena::CATEGORY_TRANSPOSITION_TABLE), 0u);
+  EXPECT_EQ(arena.mapped(), 0u);
+}
+
+TEST(Arena, hugePagesFallBackWhenNoneAreReserved)
+{
+  Arena arena(true);
+  char* p = (char*)arena.Allocate(100, Arena::CATEGORY_OPEN_SET);
+  memset(p, 0, 100);
+  EXPECT_TRUE(arena.huge_pages());
+  EXPECT_EQ(arena.mapped() % ARENA_BLOCK_SIZE, 0u);
+}
+
+TEST(NodePool, reusesFreedNodesAndRestartsAfterReset)
+{
+  Arena arena;
+  NodePool pool(100, arena);
+  std::vector<void*> nodes;
+  for (int i = 0; i < 10000; i++)
+  {
+    nodes.push_back(pool.Allocate());
+  }
+  size_t held = arena.bytes(Arena::CATEGORY_NODES);
+  EXPECT_GE(held, 10000u * 100u);
+
+  pool.Free(nodes[42]);
+  EXPECT_EQ(pool.Allocate(), nodes[42]);
+
+  pool.Reset();
+  EXPECT_EQ(pool.Allocate(), nodes[0]);
+  for (int i = 1; i < 10000; i++)
+  {
+    pool.Allocate();
+  }
+  EXPECT_EQ(arena.bytes(Arena::CATEGORY_NODES), held);
+}
@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+#include <set>
+#include <vector>
+#include <Heuristic.h>
+#include <BucketQueue.h>
+#include <Node.h>
+
+using namespace boxedin;
+using namespace testing;
+
+// Copies of the start Node with the given gscores and hscores
+static std::vector<Node> MakeNodes(size_t count, cost_t fscore, cost_t max_hscore)
+{
+  // Only the scores matter
+  auto level = Level::MakeLevel(
+      "xxxx\n"
+      "xp@x\n"
+      "xxxx\n"
+  );
+  ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+  Node start(level, heuristic);
+  std::vector<Node> nodes(count, start);
+  for (size_t i = 0; i < count; i++)
+  {
+    nodes[i].hscore_ = (cost_t)(i % (max_hscore + 1));
+    nodes[i].gscore_ = fscore - nodes[i].hscore_;
+  }
+  return nodes;
+}
+
+TEST(BucketQueue, popsLowestFscoreThenLowestHscoreNewestFirst)
+{
+  auto nodes = MakeNodes(6, 10, 2);
+  nodes[5].gscore_ = 0; // fscore 2
+  BucketQueue queue(MAX_FSCORE, BucketQueue::TIE_BREAK_LOW_H_LIFO);
+  for (auto& node : nodes)
+  {
+    queue.Push(&node);
+  }
+  EXPECT_EQ(queue.size(), 6u);
+  EXPECT_EQ(queue.MinPriority(), 2);
+
+  EXPECT_EQ(queue.Pop(), &nodes[5]);
+  EXPECT_EQ(queue.Pop(), &nodes[3]); // h = 0, newest
+  EXPECT_EQ(queue.Pop(), &nodes[0]);
+  EXPECT_EQ(queue.Pop(), &nodes[4]); // h = 1
+  EXPECT_EQ(queue.Pop(), &nodes[1]);
+  EXPECT_EQ(queue.Pop(), &nodes[2]); // h = 2
+  EXPECT_EQ(queue.Pop(), (Node*)NULL);
+  EXPECT_TRUE(queue.empty());
+  EXPECT_FALSE(BucketQueue::IsQueued(&nodes[0]));
+}
+
+TEST(BucketQueue, removeLeavesEveryOtherNodeQueued)
+{
+  const BucketQueue::TieBreaking policies[] =
+  {
+    BucketQueue::TIE_BREAK_FIFO,
+    BucketQueue::TIE_BREAK_LIFO,
+    BucketQueue::TIE_BREAK_LOW_H_FIFO,
+    BucketQueue::TIE_BREAK_LOW_H_LIFO,
+  };
+  for (auto policy : policies)
+  {
+    // Enough Nodes with the same fscore and hscore to fill several chunks
+    auto nodes = MakeNodes(2000, 20, 1);
+    BucketQueue queue(MAX_FSCORE, policy);
+    for (auto& node : nodes)
+    {
+      queue.Push(&node);
+      EXPECT_TRUE(BucketQueue::IsQueued(&node));
+    }
+
+    // Pop some Nodes first so positions no longer start at the first chunk
+    std::set<Node*> expected;
+    for (auto& node : nodes)
+    {
+      expected.insert(&node);
+    }
+    for (int i = 0; i < 300; i++)
+    {
+      expected.erase(queue.Pop());
+    }
+
+    for (size_t i = 0; i < nodes.size(); i += 3)
+    {
+      if (expected.erase(&nodes[i]))
+      {
+        queue.Remove(&nodes[i]);
+        EXPECT_FALSE(BucketQueue::IsQueued(&nodes[i]));
+      }
+    }
+    EXPECT_EQ(queue.size(), expected.size()) << policy;
+
+    std::set<Node*> popped;
+    Node* node = NULL;
+    while ((node = queue.Pop()) != NULL)
+    {
+      EXPECT_TRUE(popped.insert(node).second) << policy;
+    }
+    EXPECT_EQ(popped, expected) << policy;
+  }
+}
@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string>
+#include <DeadlockPatterns.h>
+#include <Heuristic.h>
+#include <Node.h>
+
+using namespace boxedin;
+using namespace testing;
+
+// Pushed up, the box freezes with the others around the gear in the corner
+static const char* CORNER_LEVEL =
+    "xxxxxxx\n"
+    "x* +  x\n"
+    "x++   x\n"
+    "xxp   x\n"
+    "xxxxx@x\n";
+
+// The same level, mirrored
+static const char* MIRRORED_LEVEL =
+    "xxxxxxx\n"
+    "x  + *x\n"
+    "x   ++x\n"
+    "x   pxx\n"
+    "x@xxxxx\n";
+
+TEST(DeadlockPatterns, learnsFrozenBoxesAroundAGear)
+{
+  auto level = Level::MakeLevel(CORNER_LEVEL);
+  ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+  auto node = Node::MakeStartNode(level, heuristic);
+  DeadlockPatterns patterns(level);
+
+  ActionPoint free_push(Coord(2, 2), ENCODED_PATH_DIRECTION_RIGHT, 1);
+  EXPECT_FALSE(patterns.IsDeadPush(*node, free_push));
+  EXPECT_EQ(patterns.size(), 0);
+
+  ActionPoint dead_push(Coord(2, 2), ENCODED_PATH_DIRECTION_UP, 1);
+  EXPECT_TRUE(patterns.IsDeadPush(*node, dead_push));
+  EXPECT_EQ(patterns.learned(), 1);
+  EXPECT_EQ(patterns.size(), 1);
+  EXPECT_EQ(patterns.hits(), 0);
+
+  // Found in the database the second time
+  EXPECT_TRUE(patterns.IsDeadPush(*node, dead_push));
+  EXPECT_EQ(patterns.learned(), 1);
+  EXPECT_EQ(patterns.hits(), 1);
+
+  // Once the gear is taken, nothing is left behind the boxes
+  Node taken(*node);
+  taken.gear_descriptor_.bitfield = 0;
+  EXPECT_FALSE(patterns.IsDeadPush(taken, dead_push));
+  delete node;
+}
+
+TEST(DeadlockPatterns, savedPatternsMatchInAnotherLevel)
+{
+  std::string path = TempDir() + "deadlock_patterns_test.txt";
+  {
+    auto level = Level::MakeLevel(CORNER_LEVEL);
+    ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+    auto node = Node::MakeStartNode(level, heuristic);
+    DeadlockPatterns patterns(level);
+    ActionPoint dead_push(Coord(2, 2), ENCODED_PATH_DIRECTION_UP, 1);
+    EXPECT_TRUE(patterns.IsDeadPush(*node, dead_push));
+    EXPECT_TRUE(patterns.Save(path));
+    delete node;
+  }
+
+  auto level = Level::MakeLevel(MIRRORED_LEVEL);
+  ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+  auto node = Node::MakeStartNode(level, heuristic);
+  DeadlockPatterns patterns(level);
+  EXPECT_FALSE(patterns.Load(path + ".missing"));
+  EXPECT_TRUE(patterns.Load(path));
+  EXPECT_EQ(patterns.size(), 1);
+  EXPECT_GE(patterns.instances(), 1);
+
+  ActionPoint dead_push(Coord(4, 2), ENCODED_PATH_DIRECTION_UP, 1);
+  EXPECT_TRUE(patterns.IsDeadPush(*node, dead_push));
+  EXPECT_EQ(patterns.learned(), 0);
+  EXPECT_EQ(patterns.hits(), 1);
+  delete node;
+  remove(path.c_str());
+}
@@ -0,0 +1,22 @@
+#include <gtest/gtest.h>
+#include <astar.h>
+#include <external_astar.h>
+#include <Heuristic.h>
+#include "test_levels.h"
+
+using namespace boxedin;
+using namespace testing;
+
+TEST(ExternalAStar, findsOptimalSolution)
+{
+  auto level = MakeRedAndYellowGateLevel();
+  ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+  SearchResult expected = astar(level, heuristic);
+  ASSERT_TRUE(expected.success);
+
+  // A tiny buffer forces many sorted runs to be written and merged
+  SearchResult result = external_astar(level, heuristic, TempDir(), 4096);
+  ASSERT_TRUE(result.success);
+  EXPECT_EQ(result.num_moves, expected.num_moves);
+  EXPECT_EQ((int)result.solution.size(), result.num_moves);
+}
@@ -0,0 +1,200 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <vector>
+#include <Heuristic.h>
+#include <Node.h>
+
+using namespace boxedin;
+using namespace testing;
+
+// Shortest walk from cell through the gears of gears_bitfield to the exit,
+// trying every order of the gears
+static cost_t BruteForceHscore(ShortestDistanceThroughGearsToExitHeuristic& heuristic,
+                               const Level& level, size_t cell, size_t gears_bitfield)
+{
+  size_t width = level.floor_plan_[0].size();
+  std::vector<size_t> order;
+  for (size_t i = 0; i < level.gear_coords_.size(); i++)
+  {
+    if (gears_bitfield & ((size_t)1 << i))
+    {
+      order.push_back(level.gear_coords_[i].y * width + level.gear_coords_[i].x);
+    }
+  }
+  order.push_back(level.exit_coord_.y * width + level.exit_coord_.x);
+  std::sort(order.begin(), order.end() - 1);
+
+  cost_t best = COST_INFINITY;
+  do
+  {
+    cost_t cost = 0;
+    size_t from = cell;
+    for (size_t i = 0; i < order.size() && cost != COST_INFINITY; i++)
+    {
+      cost_t dist = heuristic.cell_to_cell_dist(from, order[i]);
+      cost = (dist == COST_INFINITY) ? COST_INFINITY : cost + dist;
+      from = order[i];
+    }
+    best = std::min(best, cost);
+  } while (std::next_permutation(order.begin(), order.end() - 1));
+  return best;
+}
+
+static void ExpectBruteForceHscores(const Level& level)
+{
+  ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+  size_t width = level.floor_plan_[0].size();
+  size_t num_subsets = (size_t)1 << level.gear_coords_.size();
+  for (size_t cell = 0; cell < width * level.floor_plan_.size(); cell++)
+  {
+    if (level.floor_plan_[cell / width][cell % width] != ' ')
+    {
+      continue;
+    }
+    for (size_t gears = 0; gears < num_subsets; gears++)
+    {
+      EXPECT_EQ(heuristic.get_hscore(cell, (gears_bitfield_t)gears),
+                BruteForceHscore(heuristic, level, cell, gears))
+          << "cell " << cell << " gears " << gears;
+    }
+  }
+}
+
+TEST(Heuristic, tableMatchesEveryOrderOfTheGears)
+{
+  ExpectBruteForceHscores(Level::MakeLevel(
+      "xxxxxxxxx\n"
+      "x*  x  *x\n"
+      "x   x   x\n"
+      "x*      @\n"
+      "x   x  *x\n"
+      "xp  x*  x\n"
+      "xxxxxxxxx\n"
+  ));
+}
+
+TEST(Heuristic, unreachableGearIsInfinite)
+{
+  // The gear in the top right room cannot be reached
+  auto level = Level::MakeLevel(
+      "xxxxxxxxx\n"
+      "x*  xx *x\n"
+      "x   x xxx\n"
+      "x*      @\n"
+      "xp  x   x\n"
+      "xxxxxxxxx\n"
+  );
+  ExpectBruteForceHscores(level);
+
+  ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+  auto start = Node::MakeStartNode(level, heuristic);
+  EXPECT_EQ(heuristic.get_hscore(*start), COST_INFINITY);
+  ShortestDistanceThroughGearsToExitHeuristic tree(level, 0);
+  EXPECT_EQ(tree.get_hscore(*start), COST_INFINITY);
+  delete start;
+}
+
+TEST(Heuristic, closedGateIsPassedAfterVisitingItsSwitch)
+{
+  // The red gate is between the player and the exit. Before it opens, a box
+  // must be pushed onto the switch, which leaves the player at (2,3).
+  auto level = Level::MakeLevel(
+      "xxxxxxx\n"
+      "xp R @x\n"
+      "x xxxxx\n"
+      "x  rx''\n"
+      "xxxxx''\n"
+  );
+  ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+  size_t width = level.floor_plan_[0].size();
+  size_t player = 1 * width + 1;
+  size_t next_to_switch = 3 * width + 2;
+
+  EXPECT_EQ(heuristic.num_gates, 1);
+  EXPECT_EQ(heuristic.get_hscore(player, 1, 0), 4);
+  EXPECT_EQ(heuristic.get_hscore(player, 0, 0), 10);
+  EXPECT_EQ(heuristic.get_hscore(next_to_switch, 0, 0), 7);
+  EXPECT_EQ(heuristic.cell_to_cell_dist(player, 1 * width + 5), 4);
+}
+
+TEST(Heuristic, boxInTheWayRaisesTheExpansionBound)
+{
+  typedef ShortestDistanceThroughGearsToExitHeuristic Walk;
+
+  // The box can only be pushed down, from above; the walk ignores it
+  auto level = Level::MakeLevel(
+      "xxxxxx\n"
+      "x  xxx\n"
+      "xp+x@x\n"
+      "xx   x\n"
+      "xxxxxx\n"
+  );
+  Walk walk(level);
+  FirstPushHeuristic first_push(level, walk);
+  MaxHeuristic<Walk, FirstPushHeuristic> heuristic(walk, first_push);
+  auto start = Node::MakeStartNode(level, heuristic);
+  EXPECT_EQ(heuristic.get_hscore(*start), 5);
+  EXPECT_EQ(heuristic.get_expansion_hscore(*start), 7);
+  start->set_hscore(7);
+  EXPECT_EQ(heuristic.get_expansion_hscore(*start), 7);
+
+  // The first push bound is only checked at expansion
+  AddHeuristic<Walk, FirstPushHeuristic> sum(walk, first_push);
+  EXPECT_EQ(sum.get_hscore(*start), 5);
+  delete start;
+
+  // Nothing can be pushed, so the exit is never reached
+  auto stuck = Level::MakeLevel(
+      "xxxxx\n"
+      "xp+xx\n"
+      "xx xx\n"
+      "xx @x\n"
+      "xxxxx\n"
+  );
+  Walk stuck_walk(stuck);
+  FirstPushHeuristic stuck_first_push(stuck, stuck_walk);
+  MaxHeuristic<Walk, FirstPushHeuristic> stuck_heuristic(stuck_walk, stuck_first_push);
+  start = Node::MakeStartNode(stuck, stuck_heuristic);
+  EXPECT_EQ(stuck_heuristic.get_hscore(*start), 4);
+  EXPECT_EQ(stuck_heuristic.get_expansion_hscore(*start), COST_INFINITY);
+  delete start;
+}
+
+TEST(Heuristic, spanningTreeBoundWhenTheTableDoesNotFit)
+{
+  auto level = Level::MakeLevel(
+      "xxxxxxxxx\n"
+      "x*  x  *x\n"
+      "x   x   x\n"
+      "x*      @\n"
+      "x   x  *x\n"
+      "xp  x*  x\n"
+      "xxxxxxxxx\n"
+  );
+  ShortestDistanceThroughGearsToExitHeuristic table(level);
+  ShortestDistanceThroughGearsToExitHeuristic tree(level, 0);
+  EXPECT_TRUE(table.hscore_table != NULL);
+  EXPECT_TRUE(tree.hscore_table == NULL);
+
+  size_t width = level.floor_plan_[0].size();
+  size_t num_subsets = (size_t)1 << level.gear_coords_.size();
+  for (size_t cell = 0; cell < width * level.floor_plan_.size(); cell++)
+  {
+    if (level.floor_plan_[cell / width][cell % width] != ' ')
+    {
+      continue;
+    }
+    EXPECT_EQ(tree.get_hscore(cell, 0), table.get_hscore(cell, 0));
+    for (size_t gears = 1; gears < num_subsets; gears++)
+    {
+      // Twice, the second time from the cache
+      for (int pass = 0; pass < 2; pass++)
+      {
+        cost_t bound = tree.get_hscore(cell, (gears_bitfield_t)gears);
+        EXPECT_GT(bound, 0);
+        EXPECT_LE(bound, table.get_hscore(cell, (gears_bitfield_t)gears))
+            << "cell " << cell << " gears " << gears;
+      }
+    }
+  }
+}
@@ -0,0 +1,35 @@
+#include <gtest/gtest.h>
+#include <astar.h>
+#include <idastar.h>
+#include <Heuristic.h>
+#include "test_levels.h"
+
+using namespace boxedin;
+using namespace testing;
+
+TEST(IdaStar, findsOptimalSolutionWithoutCache)
+{
+  auto level = MakeRedGateLevel();
+  ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+  SearchResult expected = astar(level, heuristic);
+  ASSERT_TRUE(expected.success);
+
+  SearchResult result = idastar(level, heuristic, 0);
+  EXPECT_TRUE(result.success);
+  EXPECT_EQ(result.num_moves, expected.num_moves);
+  EXPECT_EQ((int)result.solution.size(), result.num_moves);
+}
+
+TEST(IdaStar, cacheReducesExpansions)
+{
+  // The walk heuristic misses the boxes in the way, so each iteration
+  // reaches states that an earlier branch of it already searched
+  auto level = MakeRedGateLevel();
+  ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+  SearchResult uncached = idastar(level, heuristic, 0);
+  SearchResult cached = idastar(level, heuristic, 1 << 20);
+  ASSERT_TRUE(uncached.success);
+  ASSERT_TRUE(cached.success);
+  EXPECT_EQ(cached.num_moves, uncached.num_moves);
+  EXPECT_LT(cached.nodes_expanded, uncached.nodes_expanded);
+}
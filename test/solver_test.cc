@@ -0,0 +1,52 @@
+#include <gtest/gtest.h>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <Solver.h>
+#include "test_levels.h"
+
+using namespace boxedin;
+using namespace testing;
+
+TEST(Solver, canSolveTheSameLevelAgain)
+{
+  Solver solver(MakeRedAndYellowGateLevel());
+  SearchResult first = solver.Solve();
+  SearchResult second = solver.Solve();
+  ASSERT_TRUE(first.success);
+  ASSERT_TRUE(second.success);
+  EXPECT_EQ(second.num_moves, first.num_moves);
+  EXPECT_EQ(second.solution, first.solution);
+  EXPECT_EQ(second.nodes_expanded, first.nodes_expanded);
+}
+
+TEST(Solver, concurrentSolversMatchOneSolver)
+{
+  Solver reference(MakeRedAndYellowGateLevel());
+  SearchResult expected = reference.Solve();
+  ASSERT_TRUE(expected.success);
+
+  const int num_solvers = 4;
+  std::vector<std::unique_ptr<Solver> > solvers;
+  std::vector<SearchResult> results(num_solvers);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_solvers; i++)
+  {
+    solvers.emplace_back(new Solver(MakeRedAndYellowGateLevel()));
+  }
+  for (int i = 0; i < num_solvers; i++)
+  {
+    threads.emplace_back([&solvers, &results, i]() { results[i] = solvers[i]->Solve(); });
+  }
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  for (int i = 0; i < num_solvers; i++)
+  {
+    EXPECT_TRUE(results[i].success);
+    EXPECT_EQ(results[i].num_moves, expected.num_moves);
+    EXPECT_EQ(results[i].solution, expected.solution);
+  }
+}
@@ -0,0 +1,62 @@
+/**
+ * \file test_levels.h
+ * \brief Levels shared by the tests that check a search engine against A*.
+ * \author Aaron Jones
+ * \date 2022
+ * \copyright GNU Public License.
+ */
+#ifndef TEST_LEVELS_H__
+#define TEST_LEVELS_H__
+
+#include <Level.h>
+
+namespace boxedin
+{
+
+// The red switch opens the gate in front of the exit. One gear is walled in
+// behind a row of boxes. Solved in 22 moves.
+static inline Level MakeRedGateLevel()
+{
+  return Level::MakeLevel(
+      "''''''''''\n"
+      "''xxx'''''\n"
+      "''x@x'''''\n"
+      "''xRxxxx''\n"
+      "''x   *x''\n"
+      "''xx r x''\n"
+      "''xx  xx''\n"
+      "''x  + x''\n"
+      "''xx+++x''\n"
+      "''x*   x''\n"
+      "''x  p x''\n"
+      "''xxxxxx''\n"
+      "''''''''''\n"
+      "''''''''''\n"
+  );
+}
+
+// The yellow gate in front of the exit and the red gate in the middle open
+// from switches at either end. Solved in 83 moves.
+static inline Level MakeRedAndYellowGateLevel()
+{
+  return Level::MakeLevel(
+      "''''xxxx''\n"
+      "''''x  rxx\n"
+      "''''x+ + x\n"
+      "''''x  x x\n"
+      "''''x *x x\n"
+      "''''xxxx x\n"
+      "'''''''x x\n"
+      "'xxxxxx  x\n"
+      "x@x +*+  x\n"
+      "xYx xRx++x\n"
+      "x   p    x\n"
+      "x+x x x+xx\n"
+      "x y      x\n"
+      "'xxxxxxxx'\n"
+  );
+}
+
+} // namespace boxedin
+
+#endif
@@ -0,0 +1,230 @@
+#include <gtest/gtest.h>
+#include <astar.h>
+#include <boxedinio.h>
+#include <Node.h>
+#include <TranspositionTable.h>
+#include "test_levels.h"
+
+using namespace boxedin;
+using namespace testing;
+
+TEST(TranspositionTable, successorHashMatchesComputedHash)
+{
+  auto level = MakeRedGateLevel();
+  ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+  auto start = Node::MakeStartNode(level, heuristic);
+  EXPECT_EQ(start->hash_, start->ComputeHash(level));
+
+  auto actions = find_actions(level, *start);
+  ASSERT_FALSE(actions.empty());
+  for (const auto& action : actions)
+  {
+    Node successor(level, heuristic, *start, action);
+    EXPECT_EQ(successor.hash_, successor.ComputeHash(level)) << action;
+    EXPECT_NE(successor.hash_, start->hash_) << action;
+  }
+  delete start;
+}
+
+TEST(TranspositionTable, tracksOpenAndClosedStates)
+{
+  auto level = MakeRedGateLevel();
+  ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+  auto start = Node::MakeStartNode(level, heuristic);
+
+  TranspositionTable table(16);
+  EXPECT_EQ(table.Insert(start, NULL), TranspositionTable::INSERTED);
+  EXPECT_EQ(table.open_size(), 1u);
+  EXPECT_EQ(table.Find(*start), start);
+  EXPECT_FALSE(table.IsClosed(*start));
+
+  // Same state, same gscore: duplicate
+  Node same(*start);
+  EXPECT_EQ(table.Insert(&same, NULL), TranspositionTable::DUPLICATE_OPEN);
+
+  // Same state, better gscore: replaces the open Node
+  Node better(*start);
+  start->gscore_ = 10;
+  Node* previous = NULL;
+  EXPECT_EQ(table.Insert(&better, &previous), TranspositionTable::IMPROVED);
+  EXPECT_EQ(previous, start);
+  EXPECT_EQ(table.Find(*start), &better);
+  EXPECT_EQ(table.open_size(), 1u);
+
+  // Only the current open Node can be closed
+  EXPECT_FALSE(table.Close(start));
+  EXPECT_TRUE(table.Close(&better));
+  EXPECT_TRUE(table.IsClosed(*start));
+  EXPECT_EQ(table.open_size(), 0u);
+  EXPECT_EQ(table.closed_size(), 1u);
+  EXPECT_EQ(table.Insert(&same, NULL), TranspositionTable::DUPLICATE_CLOSED);
+
+  delete start;
+}
+
+TEST(TranspositionTable, growsAndKeepsAllStates)
+{
+  auto level = MakeRedGateLevel();
+  ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+  auto start = Node::MakeStartNode(level, heuristic);
+
+  // Synthetic states: same boxes and gears, different hashes
+  std::vector<Node> nodes(1000, *start);
+  TranspositionTable table(16);
+  for (size_t i = 0; i < nodes.size(); i++)
+  {
+    nodes[i].box_descriptor_.bitfields[2] = i;
+    nodes[i].hash_ = nodes[i].ComputeHash(level);
+    EXPECT_EQ(table.Insert(&nodes[i], NULL), TranspositionTable::INSERTED);
+  }
+  EXPECT_EQ(table.size(), nodes.size());
+  EXPECT_GE(table.capacity(), nodes.size());
+  for (size_t i = 0; i < nodes.size(); i++)
+  {
+    EXPECT_EQ(table.Find(nodes[i]), &nodes[i]);
+  }
+  delete start;
+}
+
+TEST(TranspositionTable, mergesStatesWhosePlayerIsInTheSameRegion)
+{
+  auto level = Level::MakeLevel(
+      "xxxxxx\n"
+      "xp   x\n"
+      "x  * @\n"
+      "xxxxxx\n"
+  );
+  const LevelBitboards& bb = level.bitboards_;
+  ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+  auto start = Node::MakeStartNode(level, heuristic);
+  Bitboard region = player_region(level, *start);
+  EXPECT_EQ(region.Count(), 7);
+  EXPECT_FALSE(region.Test(bb.TileIndex(Coord(3, 2)))); // the gear
+  start->gscore_ = 5;
+  start->KeyOnRegion(level, region.First());
+
+  TranspositionTable table(16);
+  EXPECT_EQ(table.InsertInRegion(start, region, bb, NULL), TranspositionTable::INSERTED);
+
+  // Two steps away and two moves later: the start reaches it as cheaply
+  Node far(*start);
+  far.player_coord_ = Coord(3, 1);
+  far.gscore_ = 7;
+  far.KeyOnRegion(level, player_region(level, far).First());
+  EXPECT_EQ(far.hash_, start->hash_);
+  EXPECT_EQ(table.InsertInRegion(&far, region, bb, NULL), TranspositionTable::DUPLICATE_OPEN);
+  EXPECT_EQ(table.merged(), 1u);
+
+  // Neither reaches the other for less: another entry point
+  Node middle(far);
+  middle.gscore_ = 6;
+  EXPECT_EQ(table.InsertInRegion(&middle, region, bb, NULL), TranspositionTable::INSERTED);
+  EXPECT_EQ(table.open_size(), 2u);
+
+  // One step from the start and two moves cheaper: replaces it
+  Node better(far);
+  better.player_coord_ = Coord(2, 1);
+  better.gscore_ = 3;
+  Node* previous = NULL;
+  EXPECT_EQ(table.InsertInRegion(&better, region, bb, &previous), TranspositionTable::IMPROVED);
+  EXPECT_EQ(previous, start);
+  EXPECT_EQ(table.merged(), 2u);
+  EXPECT_TRUE(table.Close(&better));
+  EXPECT_TRUE(table.IsClosed(better));
+  EXPECT_FALSE(table.IsClosed(middle));
+
+  delete start;
+}
+
+TEST(TranspositionTable, mergingRegionsKeepsTheOptimalSolution)
+{
+  auto level = MakeRedGateLevel();
+  ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+  SearchResult exact = astar(level, heuristic);
+  SearchResult merged = astar(level, heuristic, BucketQueue::TIE_BREAK_LOW_H_LIFO, true);
+  ASSERT_TRUE(exact.success);
+  ASSERT_TRUE(merged.success);
+  EXPECT_EQ(merged.num_moves, exact.num_moves);
+  EXPECT_LE(merged.closedset_size, exact.closedset_size);
+}
+
+TEST(TranspositionTable, erasedStateIsForgottenAndTheOthersAreStillFound)
+{
+  auto level = MakeRedGateLevel();
+  ShortestDistanceThroughGearsToExitHeuristic heuristic(level);
+  auto start = Node::MakeStartNode(level, heuristic);
+
+  // Enough states to fill long probe sequences
+  std::vector<Node> nodes(1000, *start);
+  TranspositionTable table(16);
+  for (size_t i = 0; i < nodes.size(); i++)
+  {
+    nodes[i].box_descriptor_.bitfields[2] = i;
+    nodes[i].hash_ = nodes[i].ComputeHash(level);
+    table.Insert(&nodes[i], NULL);
+  }
+  EXPECT_TRUE(table.Close(&nodes[1]));
+  EXPECT_FALSE(table.Erase(&nodes[1]));
+
+  for (size_t i = 0; i < nodes.size(); i += 3)
+  {
+    EXPECT_TRUE(table.Erase(&nodes[i]));
+  }
+  EXPECT_EQ(table.open_size(), nodes.size() - 1 - 334);
+  for (size_t i = 0; i < nodes.size(); i++)
+  {
+    EXPECT_EQ(table.Find(nodes[i]), (i % 3) ? &nodes[i] : NULL) << i;
+  }
+  EXPECT_EQ(table.Insert(&nodes[0], NULL), TranspositionTable::INSERTED);
+  delete start;
+}
+
+// Collects the gears left to right in the fewest moves, but makes A* look
+// at that order last. The state of all three gears is first reached by a
+// detour, and the bound at expansion puts it past MAX_FSCORE. Only the
+// cheaper path to it, found later, comes in under MAX_FSCORE.
+struct DetourHeuristic : public Heuristic
+{
+  const Level& level;
+
+  explicit DetourHeuristic(const Level& level) : level(level) {}
+
+  virtual cost_t get_hscore(const Node& node)
+  {
+    gears_bitfield_t right_two = 6;
+    if (node.gear_descriptor_.bitfield == right_two)
+    {
+      return 20;
+    }
+    if (node.gear_descriptor_.bitfield == 0 &&
+        (node.player_coord_ == level.gear_coords_[0] || node.player_coord_ == level.gear_coords_[1]))
+    {
+      return MAX_FSCORE;
+    }
+    return 0;
+  }
+
+  virtual cost_t get_expansion_hscore(const Node& node)
+  {
+    if (node.gear_descriptor_.bitfield == 0 && node.player_coord_ == level.gear_coords_[2])
+    {
+      return MAX_FSCORE - 10;
+    }
+    return get_hscore(node);
+  }
+};
+
+TEST(TranspositionTable, cheaperPathToAStateDroppedAtExpansionIsSearched)
+{
+  auto level = Level::MakeLevel(
+      "xxxxxxxxx\n"
+      "x       x\n"
+      "xp * * *x\n"
+      "x       x\n"
+      "xxxxxxx@x\n"
+  );
+  DetourHeuristic heuristic(level);
+  SearchResult result = astar(level, heuristic);
+  ASSERT_TRUE(result.success);
+  EXPECT_EQ(result.num_moves, 8);
+}